@@ -0,0 +1,176 @@
+#pragma once
+
+#include "../db/tag_day_totals.hpp"
+#include "../migration.hpp"
+#include "../utils.hpp"
+
+#include <SQLiteCpp/SQLiteCpp.h>
+
+#include <absl/strings/str_split.h>
+#include <absl/time/clock.h>
+#include <absl/time/time.h>
+
+#include <fmt/format.h>
+
+#include <unistd.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Generated database of `chatsCount` wallets with `entriesPerChat` expenses spread over the last ENTRIES_DAYS days and
+// `tagsPerChat` tags each, two thirds of expenses tagged. Sizes are given to wallet_bench as `--db_size=CxExT`.
+struct BenchDb {
+    static constexpr std::int64_t FIRST_CHAT_ID = 1'000'000;
+    static constexpr int ENTRIES_DAYS = 90;
+    // Schema before the covering indexes of migration 7, with only the single column indexes of migration 1.
+    // BM_Migration applies everything after it.
+    static constexpr int LEGACY_VERSION = 6;
+
+    std::size_t chatsCount = 100;
+    std::size_t entriesPerChat = 1000;
+    std::size_t tagsPerChat = 10;
+
+    static std::optional<BenchDb> parse(std::string_view str) {
+        std::vector<std::string_view> sizes = absl::StrSplit(str, 'x');
+        if (sizes.size() != 3) {
+            return std::nullopt;
+        }
+
+        auto chats = strToT<std::size_t>(sizes[0]);
+        auto entries = strToT<std::size_t>(sizes[1]);
+        auto tags = strToT<std::size_t>(sizes[2]);
+        if (!chats || !entries || !tags || *chats == 0) {
+            return std::nullopt;
+        }
+        return BenchDb{*chats, *entries, *tags};
+    }
+
+    std::string name() const {
+        return fmt::format("{}x{}x{}", chatsCount, entriesPerChat, tagsPerChat);
+    }
+
+    std::int64_t chatId(std::size_t i) const {
+        return FIRST_CHAT_ID + static_cast<std::int64_t>(i % chatsCount);
+    }
+
+    // Fresh copy of the fully migrated database, for benchmarks that write.
+    std::filesystem::path copy(std::string_view benchmark) const {
+        return copyOf(migratedPath(), benchmark);
+    }
+
+    // Fresh copy of the database before LEGACY_VERSION + 1.
+    std::filesystem::path legacyCopy(std::string_view benchmark) const {
+        return copyOf(legacyPath(), benchmark);
+    }
+
+private:
+    static std::filesystem::path dir() {
+        static const auto dir = [] {
+            auto path = std::filesystem::temp_directory_path() / fmt::format("wallet_bench_{}", ::getpid());
+            std::filesystem::create_directories(path);
+            return path;
+        }();
+        return dir;
+    }
+
+    static std::filesystem::path migrationRoot(int maxVersion) {
+        const auto root = dir() / fmt::format("migration_{}", maxVersion);
+        if (std::filesystem::exists(root)) {
+            return root;
+        }
+
+        std::filesystem::create_directories(root / "migration");
+        const auto sourceDir = std::filesystem::path(WALLET_SOURCE_DIR) / "migration";
+        for (const auto& entry : std::filesystem::directory_iterator(sourceDir)) {
+            if (std::stoi(entry.path().filename().replace_extension("")) <= maxVersion) {
+                std::filesystem::copy_file(entry.path(), root / "migration" / entry.path().filename());
+            }
+        }
+        return root;
+    }
+
+    std::filesystem::path copyOf(const std::filesystem::path& source, std::string_view benchmark) const {
+        const auto path = dir() / fmt::format("{}_{}.db", benchmark, name());
+        std::filesystem::copy_file(source, path, std::filesystem::copy_options::overwrite_existing);
+        return path;
+    }
+
+    std::filesystem::path migratedPath() const {
+        const auto path = dir() / fmt::format("migrated_{}.db", name());
+        if (!std::filesystem::exists(path)) {
+            std::filesystem::copy_file(legacyPath(), path);
+            Connection db(path, SQLite::OPEN_READWRITE);
+            Migration(WALLET_SOURCE_DIR, db);
+            TagDayTotals::backfill(db);
+        }
+        return path;
+    }
+
+    // Filled through the legacy schema, which never changes, so the generator doesn't depend on later migrations.
+    std::filesystem::path legacyPath() const {
+        const auto path = dir() / fmt::format("legacy_{}.db", name());
+        if (std::filesystem::exists(path)) {
+            return path;
+        }
+
+        SQLite::Database db(path, SQLite::OPEN_READWRITE | SQLite::OPEN_CREATE);
+        Migration(migrationRoot(LEGACY_VERSION), db);
+
+        std::mt19937_64 rnd(42);
+        const auto now = absl::ToUnixSeconds(absl::Now());
+
+        SQLite::Transaction tr(db);
+        SQLite::Statement wallet(db, "INSERT INTO Wallets(chat_id, time_zone, day_limit) VALUES(?, 'UTC', 1000)");
+        SQLite::Statement tag(db, "INSERT INTO Tags(chat_id, tag) VALUES(?, ?)");
+        SQLite::Statement entry(db,
+            "INSERT INTO Entries(chat_id, ts, amount, descr, message_id) VALUES(?, ?, ?, ?, ?)");
+        SQLite::Statement entryTag(db, "INSERT INTO EntryTags VALUES(?, ?)");
+
+        std::int64_t nextTagId = 1;
+        for (std::size_t c = 0; c != chatsCount; ++c) {
+            const auto chatId = FIRST_CHAT_ID + static_cast<std::int64_t>(c);
+            const auto firstTagId = nextTagId;
+
+            wallet.bind(1, chatId);
+            wallet.exec();
+            wallet.reset();
+
+            for (std::size_t t = 0; t != tagsPerChat; ++t) {
+                tag.bind(1, chatId);
+                tag.bind(2, fmt::format("🏷️ Тэг {}", t));
+                tag.exec();
+                tag.reset();
+                ++nextTagId;
+            }
+
+            for (std::size_t e = 0; e != entriesPerChat; ++e) {
+                entry.bind(1, chatId);
+                entry.bind(2, now - static_cast<std::int64_t>(rnd() % (ENTRIES_DAYS * 24 * 3600)));
+                entry.bind(3, static_cast<double>(1 + rnd() % 5000));
+                entry.bind(4, "bench");
+                entry.bind(5, static_cast<std::int64_t>(e));
+                entry.exec();
+                entry.reset();
+
+                if (tagsPerChat != 0 && rnd() % 3 != 0) {
+                    entryTag.bind(1, db.getLastInsertRowid());
+                    entryTag.bind(2, firstTagId + static_cast<std::int64_t>(rnd() % tagsPerChat));
+                    entryTag.exec();
+                    entryTag.reset();
+                }
+            }
+        }
+        tr.commit();
+
+        return path;
+    }
+};
+
+// Defined in db_bench.cpp, called from main for every requested size.
+void registerDbBenchmarks(const BenchDb& db);
@@ -0,0 +1,259 @@
+#include "../db/day_report.hpp"
+#include "../db/day_sums.hpp"
+#include "../db/hot_window.hpp"
+#include "../db/storage.hpp"
+#include "../db/tag.hpp"
+#include "../db/tag_day_totals.hpp"
+#include "../db/tag_registry.hpp"
+#include "../db/wallet.hpp"
+#include "../db/wallet_aggregates.hpp"
+#include "../db/wallet_cache.hpp"
+#include "../db/wallet_entry.hpp"
+#include "bench_db.hpp"
+
+#include <benchmark/benchmark.h>
+
+#include <limits>
+
+namespace {
+
+Wallet benchWallet(std::int64_t chatId) {
+    Wallet wallet;
+    wallet.chatId = chatId;
+    wallet.timeZone = getTimeZone("UTC");
+    wallet.dayLimit = 1000;
+    return wallet;
+}
+
+void BM_WalletEntrySave(benchmark::State& state, const BenchDb& benchDb) {
+    Storage storage(benchDb.copy("save"), StorageConfig{});
+    EntryIds ids;
+    WalletAggregates aggregates;
+
+    std::size_t i = 0;
+    for (auto _ : state) {
+        WalletEntry entry;
+        entry.chatId = benchDb.chatId(i++);
+        entry.time = absl::Now();
+        entry.amount = 100;
+        entry.description = "bench";
+        entry.messageId = i;
+        entry.save(storage.writer(), ids, aggregates, absl::UTCTimeZone());
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+void BM_WalletEntryLoadForEach(benchmark::State& state, const BenchDb& benchDb) {
+    Storage storage(benchDb.copy("read"), StorageConfig{});
+    const auto now = absl::Now();
+
+    std::size_t i = 0;
+    std::size_t entriesCount = 0;
+    for (auto _ : state) {
+        WalletEntry::loadForEach(storage.writer(), benchDb.chatId(i++), now - absl::Hours(30 * 24), now,
+            [&](const WalletEntry& entry) { benchmark::DoNotOptimize(entry); ++entriesCount; });
+    }
+    state.counters["entries"] = benchmark::Counter(entriesCount, benchmark::Counter::kAvgIterations);
+}
+
+void BM_GetDaysAmountSum(benchmark::State& state, const BenchDb& benchDb) {
+    Storage storage(benchDb.copy("read"), StorageConfig{});
+
+    std::size_t i = 0;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(WalletEntry::getDaysAmountSum(storage.writer(), benchWallet(benchDb.chatId(i++)), 10));
+    }
+}
+
+void BM_GetReportByTags(benchmark::State& state, const BenchDb& benchDb) {
+    Storage storage(benchDb.copy("read"), StorageConfig{});
+
+    std::size_t i = 0;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(WalletEntry::getReportByTags(storage.writer(), benchWallet(benchDb.chatId(i++)), 30));
+    }
+}
+
+// Same days as stat_ten, from SQLite and from the loaded hot window.
+void BM_GetAmountsByDays(benchmark::State& state, const BenchDb& benchDb) {
+    Storage storage(benchDb.copy("read"), StorageConfig{});
+    const auto firstDay = absl::ToCivilDay(absl::Now(), absl::UTCTimeZone()) - 9;
+
+    std::size_t i = 0;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(
+            WalletEntry::getAmountsByDays(storage.writer(), benchWallet(benchDb.chatId(i++)), firstDay, 10));
+    }
+}
+
+void BM_HotWindowAmountsByDays(benchmark::State& state, const BenchDb& benchDb) {
+    Storage storage(benchDb.copy("read"), StorageConfig{});
+    HotWindow hotWindow(BenchDb::ENTRIES_DAYS, std::numeric_limits<std::size_t>::max());
+    const auto firstDay = absl::ToCivilDay(absl::Now(), absl::UTCTimeZone()) - 9;
+    for (std::size_t c = 0; c != benchDb.chatsCount; ++c) {
+        hotWindow.amountsByDays(storage, benchWallet(benchDb.chatId(c)), firstDay, 10);
+    }
+
+    std::size_t i = 0;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(
+            hotWindow.amountsByDays(storage, benchWallet(benchDb.chatId(i++)), firstDay, 10));
+    }
+    state.counters["bytes"] = hotWindow.bytes();
+}
+
+void BM_HotWindowReportByTags(benchmark::State& state, const BenchDb& benchDb) {
+    Storage storage(benchDb.copy("read"), StorageConfig{});
+    HotWindow hotWindow(BenchDb::ENTRIES_DAYS, std::numeric_limits<std::size_t>::max());
+    for (std::size_t c = 0; c != benchDb.chatsCount; ++c) {
+        hotWindow.reportByTags(storage, benchWallet(benchDb.chatId(c)), 30);
+    }
+
+    std::size_t i = 0;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(hotWindow.reportByTags(storage, benchWallet(benchDb.chatId(i++)), 30));
+    }
+}
+
+// Nothing stored yet: the report of yesterday backfills the whole wallet history.
+void BM_DayReportLoadCold(benchmark::State& state, const BenchDb& benchDb) {
+    Storage storage(benchDb.copy("day_report_cold"), StorageConfig{});
+    auto& db = storage.writer();
+    WalletAggregates aggregates;
+
+    std::size_t i = 0;
+    for (auto _ : state) {
+        state.PauseTiming();
+        const auto wallet = benchWallet(benchDb.chatId(i++));
+        auto clear = db.prepare("DELETE FROM DayReports WHERE chat_id = ?");
+        clear->bind(1, wallet.chatId);
+        clear->exec();
+        aggregates.clear();
+        const auto yesterday = absl::ToCivilDay(absl::Now(), wallet.timeZone) - 1;
+        state.ResumeTiming();
+
+        benchmark::DoNotOptimize(DayReport::load(db, aggregates, wallet, yesterday));
+    }
+}
+
+void BM_DayReportLoadWarm(benchmark::State& state, const BenchDb& benchDb) {
+    Storage storage(benchDb.copy("day_report_warm"), StorageConfig{});
+    auto& db = storage.writer();
+    WalletAggregates aggregates;
+    const auto yesterday = absl::ToCivilDay(absl::Now(), absl::UTCTimeZone()) - 1;
+
+    for (std::size_t c = 0; c != benchDb.chatsCount; ++c) {
+        DayReport::load(db, aggregates, benchWallet(benchDb.chatId(c)), yesterday);
+    }
+
+    std::size_t i = 0;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(DayReport::load(db, aggregates, benchWallet(benchDb.chatId(i++)), yesterday));
+    }
+}
+
+// Expenses over a 30 day range and the balance at its end, as /report_range answers them.
+void BM_DaySumsRange(benchmark::State& state, const BenchDb& benchDb) {
+    Storage storage(benchDb.copy("day_sums"), StorageConfig{});
+    auto& db = storage.writer();
+    WalletAggregates aggregates;
+    DaySumsIndex index;
+    const auto yesterday = absl::ToCivilDay(absl::Now(), absl::UTCTimeZone()) - 1;
+    for (std::size_t c = 0; c != benchDb.chatsCount; ++c) {
+        DayReport::materialize(db, aggregates, benchWallet(benchDb.chatId(c)), yesterday);
+        index.get(db, benchDb.chatId(c));
+    }
+
+    std::size_t i = 0;
+    for (auto _ : state) {
+        const auto& sums = index.get(db, benchDb.chatId(i++));
+        benchmark::DoNotOptimize(sums.expensesSum(yesterday - 30, yesterday) + sums.balance(yesterday));
+    }
+}
+
+// Loads the chat's tags and builds the keyboard, as on the first expense of a chat.
+void BM_CreateTagsKeyboardCold(benchmark::State& state, const BenchDb& benchDb) {
+    Storage storage(benchDb.copy("read"), StorageConfig{});
+
+    std::size_t i = 0;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(ChatTags::load(storage.writer(), benchDb.chatId(i)).createKeyboard(i));
+        ++i;
+    }
+}
+
+void BM_CreateTagsKeyboardWarm(benchmark::State& state, const BenchDb& benchDb) {
+    Storage storage(benchDb.copy("read"), StorageConfig{});
+    TagRegistry registry;
+    for (std::size_t c = 0; c != benchDb.chatsCount; ++c) {
+        registry.get(storage, benchDb.chatId(c));
+    }
+
+    std::size_t i = 0;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(registry.get(storage, benchDb.chatId(i))->createKeyboard(i));
+        ++i;
+    }
+}
+
+constexpr std::int64_t CACHED_WALLETS_COUNT = 10'000;
+
+// Filled by the first caller, others wait for the static to be initialized, so benchmark threads only read it.
+WalletCache& filledWalletCache() {
+    static WalletCache cache(16'384);
+    [[maybe_unused]] static const bool isFilled = [] {
+        for (std::int64_t chatId = 0; chatId != CACHED_WALLETS_COUNT; ++chatId) {
+            cache.insert(std::make_shared<const Wallet>(benchWallet(chatId)));
+        }
+        return true;
+    }();
+    return cache;
+}
+
+// Lookups of wallets of 10'000 active chats by handler threads, as every message does.
+void BM_WalletCacheFind(benchmark::State& state) {
+    auto& cache = filledWalletCache();
+
+    std::int64_t i = state.thread_index();
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(cache.find(i++ * 7919 % CACHED_WALLETS_COUNT));
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_WalletCacheFind)->Threads(1)->Threads(8);
+
+// All migrations after BenchDb::LEGACY_VERSION, including index builds and the TagDayTotals backfill, over the whole
+// database.
+void BM_Migration(benchmark::State& state, const BenchDb& benchDb) {
+    for (auto _ : state) {
+        state.PauseTiming();
+        Connection db(benchDb.legacyCopy("migration"), SQLite::OPEN_READWRITE);
+        state.ResumeTiming();
+
+        Migration(WALLET_SOURCE_DIR, db);
+        TagDayTotals::backfill(db);
+    }
+}
+
+} // namespace
+
+void registerDbBenchmarks(const BenchDb& benchDb) {
+    auto add = [&](const char* name, void (*fn)(benchmark::State&, const BenchDb&)) {
+        return benchmark::RegisterBenchmark(fmt::format("{}/{}", name, benchDb.name()).c_str(),
+            [fn, benchDb](benchmark::State& state) { fn(state, benchDb); });
+    };
+
+    add("BM_WalletEntrySave", BM_WalletEntrySave);
+    add("BM_WalletEntryLoadForEach", BM_WalletEntryLoadForEach);
+    add("BM_GetDaysAmountSum", BM_GetDaysAmountSum);
+    add("BM_GetReportByTags", BM_GetReportByTags);
+    add("BM_GetAmountsByDays", BM_GetAmountsByDays);
+    add("BM_HotWindowAmountsByDays", BM_HotWindowAmountsByDays);
+    add("BM_HotWindowReportByTags", BM_HotWindowReportByTags);
+    add("BM_DayReportLoadCold", BM_DayReportLoadCold);
+    add("BM_DayReportLoadWarm", BM_DayReportLoadWarm);
+    add("BM_DaySumsRange", BM_DaySumsRange);
+    add("BM_CreateTagsKeyboardCold", BM_CreateTagsKeyboardCold);
+    add("BM_CreateTagsKeyboardWarm", BM_CreateTagsKeyboardWarm);
+    add("BM_Migration", BM_Migration)->Unit(benchmark::kMillisecond)->Iterations(3);
+}
@@ -0,0 +1,311 @@
+#pragma once
+
+#include <absl/time/clock.h>
+#include <absl/time/time.h>
+
+#include <fmt/format.h>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// Local stand-in for the Bot API over plain HTTP/1.1 on 127.0.0.1. Serves updates pushed by the load generator through
+// getUpdates and answers every other method with a plausible result, reporting each call to the observer. Only the
+// subset of HTTP and multipart that TgBot and libcurl actually send is understood.
+class FakeBotApi {
+public:
+    struct Call {
+        std::string method;
+        std::unordered_map<std::string, std::string> params;
+        // Message created by sendMessage, sendPhoto or editMessageText.
+        std::int32_t messageId;
+        absl::Time time;
+    };
+
+    using Observer = std::function<void(const Call& call)>;
+
+    explicit FakeBotApi(Observer observer): _observer(std::move(observer)) {
+        _listenFd = ::socket(AF_INET, SOCK_STREAM, 0);
+        int reuse = 1;
+        ::setsockopt(_listenFd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        socklen_t addrLen = sizeof(addr);
+        if (::bind(_listenFd, reinterpret_cast<sockaddr*>(&addr), addrLen) != 0 || ::listen(_listenFd, 64) != 0 ||
+            ::getsockname(_listenFd, reinterpret_cast<sockaddr*>(&addr), &addrLen) != 0) {
+            ::close(_listenFd);
+            throw std::runtime_error("FakeBotApi: can't listen on 127.0.0.1");
+        }
+        _port = ntohs(addr.sin_port);
+
+        _acceptThread = std::thread([this]() { acceptConnections(); });
+    }
+
+    ~FakeBotApi() {
+        {
+            std::unique_lock lk(_mutex);
+            _isRunning = false;
+            for (auto fd : _connectionFds) {
+                ::shutdown(fd, SHUT_RDWR);
+            }
+        }
+        _hasUpdates.notify_all();
+        ::shutdown(_listenFd, SHUT_RDWR);
+        ::close(_listenFd);
+
+        _acceptThread.join();
+        for (auto& thread : _connectionThreads) {
+            thread.join();
+        }
+    }
+
+    std::string url() const {
+        return fmt::format("http://127.0.0.1:{}", _port);
+    }
+
+    std::int32_t nextMessageId() {
+        return _nextMessageId++;
+    }
+
+    // `update` is the JSON of an Update without its update_id.
+    void pushUpdate(std::string_view update) {
+        {
+            std::unique_lock lk(_mutex);
+            const auto id = _nextUpdateId++;
+            _updates.push_back({id, fmt::format(R"({{"update_id":{},{})", id, update.substr(1))});
+        }
+        _hasUpdates.notify_all();
+    }
+
+    static std::string messageJson(std::int64_t chatId, std::int32_t messageId, std::string_view text) {
+        return fmt::format(R"({{"message_id":{},"date":{},"chat":{{"id":{},"type":"private"}},)"
+                           R"("from":{{"id":{},"is_bot":false,"first_name":"load"}},"text":"{}"}})",
+            messageId, absl::ToUnixSeconds(absl::Now()), chatId, chatId, text);
+    }
+
+private:
+    struct Request {
+        std::string method;
+        std::unordered_map<std::string, std::string> params;
+    };
+
+    void acceptConnections() {
+        while (true) {
+            const auto fd = ::accept(_listenFd, nullptr, nullptr);
+            if (fd < 0) {
+                return;
+            }
+
+            std::unique_lock lk(_mutex);
+            if (!_isRunning) {
+                ::close(fd);
+                return;
+            }
+            _connectionFds.push_back(fd);
+            _connectionThreads.emplace_back([this, fd]() {
+                serve(fd);
+                ::close(fd);
+            });
+        }
+    }
+
+    void serve(int fd) {
+        std::string buffer;
+        while (true) {
+            std::size_t headersEnd;
+            while ((headersEnd = buffer.find("\r\n\r\n")) == std::string::npos) {
+                if (!readMore(fd, buffer)) {
+                    return;
+                }
+            }
+
+            const std::string_view head(buffer.data(), headersEnd);
+            std::size_t contentLength = 0;
+            std::string boundary;
+            bool expectsContinue = false;
+            for (std::size_t lineStart = 0; lineStart < head.size();) {
+                const auto lineEnd = std::min(head.find("\r\n", lineStart), head.size());
+                const auto line = head.substr(lineStart, lineEnd - lineStart);
+                lineStart = lineEnd + 2;
+
+                if (hasHeader(line, "Content-Length:")) {
+                    contentLength = std::stoul(std::string(line.substr(15)));
+                } else if (hasHeader(line, "Content-Type:")) {
+                    if (auto pos = line.find("boundary="); pos != std::string_view::npos) {
+                        boundary = line.substr(pos + 9);
+                    }
+                } else if (hasHeader(line, "Expect:")) {
+                    expectsContinue = true;
+                }
+            }
+
+            if (expectsContinue && buffer.size() == headersEnd + 4) {
+                sendAll(fd, "HTTP/1.1 100 Continue\r\n\r\n");
+            }
+            while (buffer.size() < headersEnd + 4 + contentLength) {
+                if (!readMore(fd, buffer)) {
+                    return;
+                }
+            }
+
+            const std::string_view requestLine = head.substr(0, head.find("\r\n"));
+            const std::string_view target = requestLine.substr(requestLine.find(' ') + 1);
+            std::string_view path = target.substr(0, target.find_first_of(" ?"));
+
+            Request request;
+            request.method = path.substr(path.rfind('/') + 1);
+            if (!boundary.empty()) {
+                parseMultipart(std::string_view(buffer).substr(headersEnd + 4, contentLength), boundary,
+                    request.params);
+            }
+            buffer.erase(0, headersEnd + 4 + contentLength);
+
+            std::string body;
+            try {
+                body = handle(request);
+            } catch (const std::exception& e) {
+                body = fmt::format(R"({{"ok":false,"error_code":400,"description":"{}"}})", e.what());
+            }
+            sendAll(fd, fmt::format("HTTP/1.1 200 OK\r\nContent-Type: application/json\r\nContent-Length: {}\r\n\r\n{}",
+                            body.size(), body));
+        }
+    }
+
+    static bool hasHeader(std::string_view line, std::string_view name) {
+        return line.size() >= name.size() && std::equal(name.begin(), name.end(), line.begin(), [](char a, char b) {
+            return std::tolower(static_cast<unsigned char>(a)) == std::tolower(static_cast<unsigned char>(b));
+        });
+    }
+
+    static bool readMore(int fd, std::string& buffer) {
+        char chunk[16 * 1024];
+        const auto n = ::recv(fd, chunk, sizeof(chunk), 0);
+        if (n <= 0) {
+            return false;
+        }
+        buffer.append(chunk, n);
+        return true;
+    }
+
+    static void sendAll(int fd, std::string_view data) {
+        while (!data.empty()) {
+            const auto n = ::send(fd, data.data(), data.size(), MSG_NOSIGNAL);
+            if (n <= 0) {
+                return;
+            }
+            data.remove_prefix(n);
+        }
+    }
+
+    static void parseMultipart(std::string_view body, const std::string& boundary,
+        std::unordered_map<std::string, std::string>& params) {
+        const auto delimiter = "--" + boundary;
+        for (auto pos = body.find(delimiter); pos != std::string_view::npos;) {
+            const auto partStart = pos + delimiter.size();
+            pos = body.find(delimiter, partStart);
+            const auto part = body.substr(partStart, pos == std::string_view::npos ? pos : pos - partStart);
+
+            const auto partHeadEnd = part.find("\r\n\r\n");
+            const auto namePos = part.find("name=\"");
+            if (partHeadEnd == std::string_view::npos || namePos == std::string_view::npos || namePos > partHeadEnd) {
+                continue;
+            }
+            const auto nameEnd = part.find('"', namePos + 6);
+            auto value = part.substr(partHeadEnd + 4);
+            if (value.size() >= 2 && value.substr(value.size() - 2) == "\r\n") {
+                value.remove_suffix(2);
+            }
+            params[std::string(part.substr(namePos + 6, nameEnd - namePos - 6))] = value;
+        }
+    }
+
+    std::string handle(const Request& request) {
+        if (request.method == "getUpdates") {
+            return getUpdates(request);
+        }
+
+        Call call{request.method, request.params, 0, absl::Now()};
+        std::string result = "true";
+        if (request.method == "sendMessage" || request.method == "sendPhoto" || request.method == "editMessageText") {
+            const auto chatId = std::stoll(request.params.at("chat_id"));
+            call.messageId = request.method == "editMessageText" ? std::stoi(request.params.at("message_id"))
+                                                                  : nextMessageId();
+            result = messageJson(chatId, call.messageId, "");
+            if (request.method == "sendPhoto") {
+                result.pop_back();
+                result += fmt::format(R"(,"photo":[{{"file_id":"photo-{0}","file_unique_id":"photo-{0}",)"
+                                      R"("width":512,"height":512}}]}})",
+                    call.messageId);
+            }
+        }
+
+        _observer(call);
+        return fmt::format(R"({{"ok":true,"result":{}}})", result);
+    }
+
+    std::string getUpdates(const Request& request) {
+        auto param = [&](const char* name, std::int64_t defaultValue) {
+            auto found = request.params.find(name);
+            return found == request.params.end() ? defaultValue : std::stoll(found->second);
+        };
+        const auto offset = param("offset", 0);
+        const auto limit = static_cast<std::size_t>(param("limit", 100));
+        const auto timeout = absl::Seconds(param("timeout", 0));
+
+        std::unique_lock lk(_mutex);
+        while (!_updates.empty() && _updates.front().id < offset) {
+            _updates.pop_front();
+        }
+        _hasUpdates.wait_for(lk, absl::ToChronoMilliseconds(timeout),
+            [&]() { return !_updates.empty() || !_isRunning; });
+
+        std::string result = R"({"ok":true,"result":[)";
+        for (std::size_t i = 0; i != std::min(limit, _updates.size()); ++i) {
+            if (i != 0) {
+                result += ',';
+            }
+            result += _updates[i].json;
+        }
+        result += "]}";
+        return result;
+    }
+
+private:
+    struct Update {
+        std::int64_t id;
+        std::string json;
+    };
+
+    Observer _observer;
+    int _listenFd;
+    std::uint16_t _port;
+    std::atomic<std::int32_t> _nextMessageId = 1;
+
+    std::mutex _mutex;
+    std::condition_variable _hasUpdates;
+    std::deque<Update> _updates;
+    std::int64_t _nextUpdateId = 1;
+    bool _isRunning = true;
+
+    std::thread _acceptThread;
+    std::vector<int> _connectionFds;
+    std::vector<std::thread> _connectionThreads;
+};
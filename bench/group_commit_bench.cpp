@@ -0,0 +1,66 @@
+#include "../db/group_commit.hpp"
+#include "../db/storage.hpp"
+#include "../db/wallet_aggregates.hpp"
+#include "../db/wallet_entry.hpp"
+#include "../migration.hpp"
+
+#include <benchmark/benchmark.h>
+
+#include <filesystem>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace {
+
+constexpr std::size_t INSERTS_PER_PRODUCER = 64;
+
+// Inserts/sec of expenses submitted by concurrent producers against the batch window in microseconds. Runs with
+// synchronous=FULL, so every commit is a real fsync, as with the rollback journal the bot used before.
+void BM_GroupCommitInserts(benchmark::State& state) {
+    const auto window = absl::Microseconds(state.range(0));
+    const auto producersCount = static_cast<std::size_t>(state.range(1));
+
+    const auto dir = std::filesystem::temp_directory_path() / "wallet_bench_group_commit";
+    std::filesystem::remove_all(dir);
+    std::filesystem::create_directories(dir);
+
+    StorageConfig config;
+    config.synchronous = "FULL";
+    Storage storage(dir / "wallet.db", config);
+    Migration(WALLET_SOURCE_DIR, storage.writer());
+
+    std::mutex storageMutex;
+    EntryIds ids;
+    WalletAggregates aggregates;
+    GroupCommitWriter writer(storage.writer(), storageMutex, 64, window);
+
+    for (auto _ : state) {
+        std::vector<std::thread> producers;
+        for (std::size_t p = 0; p != producersCount; ++p) {
+            producers.emplace_back([&, p]() {
+                for (std::size_t i = 0; i != INSERTS_PER_PRODUCER; ++i) {
+                    WalletEntry entry;
+                    entry.chatId = p;
+                    entry.time = absl::Now();
+                    entry.amount = i;
+                    entry.description = "bench";
+                    entry.messageId = i;
+                    writer.submit([&](Connection& db) { entry.save(db, ids, aggregates, absl::UTCTimeZone()); }).get();
+                }
+            });
+        }
+        for (auto& producer : producers) {
+            producer.join();
+        }
+    }
+
+    state.SetItemsProcessed(state.iterations() * producersCount * INSERTS_PER_PRODUCER);
+}
+BENCHMARK(BM_GroupCommitInserts)
+    ->ArgNames({"window_us", "producers"})
+    ->ArgsProduct({{0, 1000, 5000}, {1, 16}})
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+
+} // namespace
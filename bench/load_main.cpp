@@ -0,0 +1,281 @@
+#include "../server.hpp"
+#include "fake_bot_api.hpp"
+
+#include <pangomm/init.h>
+
+#include <algorithm>
+#include <array>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <random>
+#include <unistd.h>
+
+// End-to-end load test: runs Server against FakeBotApi and feeds it updates of many synthetic chats at a fixed rate.
+// Latency of an update is the time from its appearance in getUpdates to the bot call that answers it: the reaction for
+// an expense, deleting the keyboard for a tag callback, the photo for a report.
+//
+//     wallet_load [--chats=1000] [--rate=200] [--duration=30] [--tag_share=0.15] [--report_share=0.05] [--root=DIR]
+//
+// `--root` runs the bot on an existing directory, e.g. with a prepared wallet.db or storage.conf.
+
+namespace {
+
+enum class Kind : std::size_t {
+    SETUP,
+    EXPENSE,
+    TAG,
+    REPORT,
+    COUNT,
+};
+
+constexpr const char* KIND_NAMES[] = {"setup", "expense", "tag", "report"};
+
+struct Options {
+    std::size_t chats = 1000;
+    double rate = 200;
+    absl::Duration duration = absl::Seconds(30);
+    double tagShare = 0.15;
+    double reportShare = 0.05;
+    std::filesystem::path root;
+
+    static Options parse(int argc, char** argv) {
+        Options options;
+        for (int i = 1; i != argc; ++i) {
+            std::pair<std::string_view, std::string_view> kv = absl::StrSplit(argv[i], absl::MaxSplits('=', 1));
+            if (kv.first == "--chats") {
+                options.chats = strToT<std::size_t>(kv.second).value_or(options.chats);
+            } else if (kv.first == "--rate") {
+                options.rate = strToDouble(kv.second).value_or(options.rate);
+            } else if (kv.first == "--duration") {
+                options.duration = absl::Seconds(strToDouble(kv.second).value_or(30));
+            } else if (kv.first == "--tag_share") {
+                options.tagShare = strToDouble(kv.second).value_or(options.tagShare);
+            } else if (kv.first == "--report_share") {
+                options.reportShare = strToDouble(kv.second).value_or(options.reportShare);
+            } else if (kv.first == "--root") {
+                options.root = kv.second;
+            } else {
+                throw std::invalid_argument(fmt::format("unknown option {}", argv[i]));
+            }
+        }
+        return options;
+    }
+};
+
+// Matches bot calls to the updates they answer.
+class Tracker {
+public:
+    void expect(Kind kind, std::int64_t chatId, std::int32_t messageId, absl::Time sentAt) {
+        std::unique_lock lk(_mutex);
+        if (kind == Kind::REPORT) {
+            _reports[chatId].push_back(sentAt);
+        } else {
+            _pending[{chatId, messageId}] = {kind, sentAt};
+        }
+        ++_expected;
+    }
+
+    void onCall(const FakeBotApi::Call& call) {
+        std::unique_lock lk(_mutex);
+        auto param = [&](const char* name) -> std::string_view {
+            auto found = call.params.find(name);
+            return found == call.params.end() ? std::string_view() : found->second;
+        };
+        const auto chatId = strToT<std::int64_t>(param("chat_id")).value_or(0);
+
+        if (call.method == "setMessageReaction" || call.method == "deleteMessage") {
+            auto found = _pending.find({chatId, strToT<std::int32_t>(param("message_id")).value_or(0)});
+            if (found != _pending.end()) {
+                complete(found->second.kind, call.time - found->second.sentAt);
+                _pending.erase(found);
+            }
+        } else if (call.method == "sendPhoto") {
+            auto& reports = _reports[chatId];
+            if (!reports.empty()) {
+                complete(Kind::REPORT, call.time - reports.front());
+                reports.pop_front();
+            }
+        } else if (call.method == "sendMessage") {
+            // Keyboard under a new expense, the first tag button is pressed later by the generator.
+            const auto markup = param("reply_markup");
+            const std::string_view prefix = R"("callback_data":")";
+            for (auto pos = markup.find(prefix); pos != std::string_view::npos; pos = markup.find(prefix, pos + 1)) {
+                const auto data = markup.substr(pos + prefix.size(), markup.find('"', pos + prefix.size()) - pos -
+                                                                         prefix.size());
+                if (absl::StartsWith(data, std::string(ADD_ENTRY_TAG) + " ")) {
+                    _keyboards[chatId] = {call.messageId, std::string(data)};
+                    break;
+                }
+            }
+            // Answer to /add_tag.
+            if (absl::StartsWith(param("text"), "✅")) {
+                auto found = _pending.find({chatId, 0});
+                if (found != _pending.end()) {
+                    complete(found->second.kind, call.time - found->second.sentAt);
+                    _pending.erase(found);
+                }
+            }
+        }
+    }
+
+    std::optional<std::pair<std::int32_t, std::string>> takeKeyboard(std::int64_t chatId) {
+        std::unique_lock lk(_mutex);
+        auto found = _keyboards.find(chatId);
+        if (found == _keyboards.end()) {
+            return std::nullopt;
+        }
+        auto keyboard = std::move(found->second);
+        _keyboards.erase(found);
+        return keyboard;
+    }
+
+    bool waitAll(absl::Duration timeout) {
+        std::unique_lock lk(_mutex);
+        return _allDone.wait_for(lk, absl::ToChronoMilliseconds(timeout), [&]() { return _done == _expected; });
+    }
+
+    void reset() {
+        std::unique_lock lk(_mutex);
+        for (auto& latencies : _latencies) {
+            latencies.clear();
+        }
+        _done = _expected = 0;
+        _pending.clear();
+        _reports.clear();
+        _lastDoneAt = absl::Now();
+    }
+
+    void print(absl::Time startedAt) const {
+        std::unique_lock lk(_mutex);
+        const auto seconds = absl::ToDoubleSeconds(_lastDoneAt - startedAt);
+        fmt::print("answered {} of {} updates in {:.1f}s: {:.1f} updates/sec\n", _done, _expected, seconds,
+            seconds > 0 ? _done / seconds : 0);
+        fmt::print("{:<10}{:>10}{:>12}{:>12}{:>12}\n", "kind", "count", "p50 ms", "p99 ms", "max ms");
+        for (std::size_t kind = 0; kind != _latencies.size(); ++kind) {
+            auto latencies = _latencies[kind];
+            if (latencies.empty()) {
+                continue;
+            }
+            std::sort(latencies.begin(), latencies.end());
+            auto percentile = [&](double p) { return latencies[static_cast<std::size_t>(p * (latencies.size() - 1))]; };
+            fmt::print("{:<10}{:>10}{:>12.2f}{:>12.2f}{:>12.2f}\n", KIND_NAMES[kind], latencies.size(),
+                percentile(0.5), percentile(0.99), latencies.back());
+        }
+    }
+
+private:
+    struct Pending {
+        Kind kind;
+        absl::Time sentAt;
+    };
+
+    struct PairHash {
+        std::size_t operator()(const std::pair<std::int64_t, std::int32_t>& key) const noexcept {
+            return std::hash<std::int64_t>{}(key.first * 31 + key.second);
+        }
+    };
+
+    void complete(Kind kind, absl::Duration latency) {
+        _latencies[static_cast<std::size_t>(kind)].push_back(absl::ToDoubleMilliseconds(latency));
+        _lastDoneAt = absl::Now();
+        if (++_done == _expected) {
+            _allDone.notify_all();
+        }
+    }
+
+    mutable std::mutex _mutex;
+    std::condition_variable _allDone;
+    std::size_t _expected = 0;
+    std::size_t _done = 0;
+    absl::Time _lastDoneAt;
+    std::array<std::vector<double>, static_cast<std::size_t>(Kind::COUNT)> _latencies;
+
+    std::unordered_map<std::pair<std::int64_t, std::int32_t>, Pending, PairHash> _pending;
+    std::unordered_map<std::int64_t, std::deque<absl::Time>> _reports;
+    std::unordered_map<std::int64_t, std::pair<std::int32_t, std::string>> _keyboards;
+};
+
+std::filesystem::path prepareRoot(const Options& options) {
+    if (!options.root.empty()) {
+        return options.root;
+    }
+
+    const auto root = std::filesystem::temp_directory_path() / fmt::format("wallet_load_{}", ::getpid());
+    std::filesystem::create_directories(root);
+    std::ofstream(root / "token") << "load";
+    std::filesystem::create_directory_symlink(std::filesystem::path(WALLET_SOURCE_DIR) / "migration",
+        root / "migration");
+    return root;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    Pango::init();
+
+    const auto options = Options::parse(argc, argv);
+    const auto root = prepareRoot(options);
+
+    Tracker tracker;
+    FakeBotApi api([&](const FakeBotApi::Call& call) { tracker.onCall(call); });
+
+    // Server polls from its constructor and never returns, the process exits when the report is printed.
+    std::thread([root, url = api.url()]() { Server server(root, url); }).detach();
+
+    auto pushMessage = [&](Kind kind, std::int64_t chatId, std::string_view text) {
+        const auto messageId = api.nextMessageId();
+        // /add_tag is answered by a message, not by a reaction on this one.
+        tracker.expect(kind, chatId, kind == Kind::SETUP && absl::StartsWith(text, "/add_tag") ? 0 : messageId,
+            absl::Now());
+        api.pushUpdate(fmt::format(R"({{"message":{}}})", FakeBotApi::messageJson(chatId, messageId, text)));
+    };
+
+    const std::int64_t firstChatId = 1'000'000;
+    const auto setupStartedAt = absl::Now();
+    for (std::size_t i = 0; i != options.chats; ++i) {
+        pushMessage(Kind::SETUP, firstChatId + i, "/add_tag 🍔 Еда");
+        pushMessage(Kind::SETUP, firstChatId + i, "/set_day_limit 1000");
+    }
+    if (!tracker.waitAll(absl::Minutes(1))) {
+        fmt::print("setup was not answered in time\n");
+    }
+    tracker.print(setupStartedAt);
+    tracker.reset();
+
+    std::mt19937_64 random(42);
+    std::uniform_int_distribution<std::size_t> chats(0, options.chats - 1);
+    std::uniform_real_distribution<double> shares(0, 1);
+
+    const auto startedAt = absl::Now();
+    const auto interval = absl::Seconds(1 / options.rate);
+    for (auto next = startedAt; next < startedAt + options.duration; next += interval) {
+        absl::SleepFor(next - absl::Now());
+
+        const auto chatId = firstChatId + static_cast<std::int64_t>(chats(random));
+        const auto share = shares(random);
+        if (share < options.reportShare) {
+            pushMessage(Kind::REPORT, chatId, share < options.reportShare / 2 ? "/report_7" : "/total_report_7");
+            continue;
+        }
+        if (share < options.reportShare + options.tagShare) {
+            if (auto keyboard = tracker.takeKeyboard(chatId)) {
+                tracker.expect(Kind::TAG, chatId, keyboard->first, absl::Now());
+                api.pushUpdate(fmt::format(R"({{"callback_query":{{"id":"{}","from":{{"id":{},"is_bot":false,)"
+                                           R"("first_name":"load"}},"message":{},"chat_instance":"load","data":"{}"}}}})",
+                    keyboard->first, chatId, FakeBotApi::messageJson(chatId, keyboard->first, "❔ Добавить тэг?"),
+                    keyboard->second));
+                continue;
+            }
+        }
+        pushMessage(Kind::EXPENSE, chatId, fmt::format("{} load", 1 + random() % 500));
+    }
+
+    if (!tracker.waitAll(absl::Seconds(30))) {
+        fmt::print("some updates were not answered in time\n");
+    }
+    tracker.print(startedAt);
+
+    std::fflush(stdout);
+    std::_Exit(0);
+}
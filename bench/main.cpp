@@ -0,0 +1,46 @@
+#include "bench_db.hpp"
+
+#include <benchmark/benchmark.h>
+#include <pangomm/init.h>
+
+#include <iostream>
+#include <vector>
+
+// Besides the usual benchmark flags accepts `--db_size=CHATSxENTRIESxTAGS`, any number of times, to run the db/
+// benchmarks on databases of these sizes. The default is 100x1000x10.
+int main(int argc, char** argv) {
+    Pango::init();
+
+    std::vector<BenchDb> dbs;
+    std::vector<char*> args;
+    for (int i = 0; i != argc; ++i) {
+        constexpr std::string_view DB_SIZE_FLAG = "--db_size=";
+        if (std::string_view(argv[i]).substr(0, DB_SIZE_FLAG.size()) != DB_SIZE_FLAG) {
+            args.push_back(argv[i]);
+            continue;
+        }
+
+        auto db = BenchDb::parse(argv[i] + DB_SIZE_FLAG.size());
+        if (!db) {
+            std::cerr << "Invalid " << argv[i] << ", expected --db_size=CHATSxENTRIESxTAGS\n";
+            return 1;
+        }
+        dbs.push_back(*db);
+    }
+    if (dbs.empty()) {
+        dbs.emplace_back();
+    }
+    for (const auto& db : dbs) {
+        registerDbBenchmarks(db);
+    }
+
+    int argsCount = args.size();
+    benchmark::Initialize(&argsCount, args.data());
+    if (benchmark::ReportUnrecognizedArguments(argsCount, args.data())) {
+        return 1;
+    }
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+
+    return 0;
+}
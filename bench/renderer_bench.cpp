@@ -0,0 +1,62 @@
+#include "../renderer.hpp"
+#include "../table.hpp"
+#include "../utils.hpp"
+
+#include <benchmark/benchmark.h>
+
+#include <fmt/format.h>
+
+namespace {
+
+Table makeReportTable(std::size_t daysCount) {
+    Table table;
+    table.setSize({4, 1});
+    table.setContentLastRow(0, "Дата 📅");
+    table.setContentLastRow(1, "Траты 💸");
+    table.setContentLastRow(2, "Баланс ⚖️");
+    table.pushRow();
+
+    for (std::size_t i = 0; i != daysCount; ++i) {
+        table.pushRow();
+        table.setContentLastRow(0, fmt::format("{:02d}/{:02d}/{}", i % 28 + 1, i / 28 % 12 + 1, 26));
+        table.setContentLastRow(1, formatWithApostrophes(i * 137 % 5000));
+        table.setContentLastRow(2, formatWithApostrophes(1000 - i * 211 % 3000));
+        table.setContentLastRow(3, i % 3 ? "🟩" : "🟥");
+    }
+    table.pushRow();
+    table.pushRow();
+    table.setContentLastRow(0, "💰💲 Всего");
+    table.setContentLastRow(2, formatWithApostrophes(123456));
+
+    table.setColumnAlign(1, Align::RIGHT);
+    table.setColumnAlign(2, Align::RIGHT);
+
+    return table;
+}
+
+// Cost of a measurement when the Cairo/Pango setup is not reused, as every calcTextSize call used to pay.
+void BM_calcTextSizeFreshContext(benchmark::State& state) {
+    for (auto _ : state) {
+        TextMeasurer measurer;
+        benchmark::DoNotOptimize(measurer.textSize("01/02/26"));
+    }
+}
+BENCHMARK(BM_calcTextSizeFreshContext);
+
+void BM_calcTextSize(benchmark::State& state) {
+    std::size_t i = 0;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(calcTextSize(formatWithApostrophes(i++ % 512)));
+    }
+}
+BENCHMARK(BM_calcTextSize);
+
+void BM_TableRender(benchmark::State& state) {
+    for (auto _ : state) {
+        auto table = makeReportTable(state.range(0));
+        benchmark::DoNotOptimize(table.render());
+    }
+}
+BENCHMARK(BM_TableRender)->Arg(7)->Arg(30);
+
+} // namespace
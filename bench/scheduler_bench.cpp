@@ -0,0 +1,45 @@
+#include "../scheduler.hpp"
+
+#include <benchmark/benchmark.h>
+
+#include <random>
+#include <vector>
+
+namespace {
+
+// Schedule + cancel pairs on top of `state.range(0)` pending far-future tasks, as with one timer per wallet.
+void BM_SchedulerScheduleCancel(benchmark::State& state) {
+    Scheduler scheduler;
+    const auto base = absl::Now() + absl::Hours(24);
+
+    std::mt19937 rnd(42);
+    for (std::int64_t i = 0; i != state.range(0); ++i) {
+        scheduler.schedule(base + absl::Seconds(rnd() % 86400), [](absl::Time) {});
+    }
+
+    for (auto _ : state) {
+        const auto id = scheduler.schedule(base + absl::Seconds(rnd() % 86400), [](absl::Time) {});
+        scheduler.removeTask(id);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_SchedulerScheduleCancel)->Arg(1'000)->Arg(100'000);
+
+void BM_SchedulerReschedule(benchmark::State& state) {
+    Scheduler scheduler;
+    const auto base = absl::Now() + absl::Hours(24);
+
+    std::mt19937 rnd(42);
+    std::vector<std::size_t> ids;
+    for (std::int64_t i = 0; i != state.range(0); ++i) {
+        ids.push_back(scheduler.schedule(base + absl::Seconds(rnd() % 86400), [](absl::Time) {}));
+    }
+
+    for (auto _ : state) {
+        scheduler.reschedule(ids[rnd() % ids.size()], base + absl::Seconds(rnd() % 86400));
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_SchedulerReschedule)->Arg(1'000)->Arg(100'000);
+
+} // namespace
@@ -0,0 +1,38 @@
+#include "../utils.hpp"
+
+#include <benchmark/benchmark.h>
+
+#include <string>
+#include <vector>
+
+namespace {
+
+void BM_strToDouble(benchmark::State& state) {
+    const std::vector<std::string> amounts = {"150", "1337.5", "42", "99999", "0.25", "abc"};
+
+    std::size_t i = 0;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(strToDouble(amounts[i++ % amounts.size()]));
+    }
+}
+BENCHMARK(BM_strToDouble);
+
+void BM_formatWithApostrophes(benchmark::State& state) {
+    std::int64_t i = 0;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(formatWithApostrophes(i++ * 7919 % 10'000'000 - 5'000'000));
+    }
+}
+BENCHMARK(BM_formatWithApostrophes);
+
+void BM_getTimeZone(benchmark::State& state) {
+    const std::vector<std::string> names = {"Europe/Moscow", "UTC", "Asia/Yekaterinburg", "Europe/Berlin"};
+
+    std::size_t i = 0;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(getTimeZone(names[i++ % names.size()]));
+    }
+}
+BENCHMARK(BM_getTimeZone);
+
+} // namespace
@@ -0,0 +1,108 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// Map that keeps at most `capacity` values. When it is full, a CLOCK hand sweeps the slots and evicts the first value
+// that wasn't looked up since the hand last passed it, which approximates LRU without reordering on every lookup. Not
+// synchronized.
+template<class Key, class Value>
+class ClockMap {
+public:
+    explicit ClockMap(std::size_t capacity): _capacity(std::max<std::size_t>(1, capacity)) {}
+
+    std::size_t size() const noexcept {
+        return _slots.size();
+    }
+
+    std::size_t evictionsCount() const noexcept {
+        return _evictionsCount;
+    }
+
+    // Unlike find(), doesn't count as a use.
+    bool contains(const Key& key) const {
+        return _index.count(key) != 0;
+    }
+
+    Value* find(const Key& key) {
+        auto found = _index.find(key);
+        if (found == _index.end()) {
+            return nullptr;
+        }
+
+        auto& slot = _slots[found->second];
+        slot.isReferenced = true;
+        return &slot.value;
+    }
+
+    // Replaces the value of `key` if there is one. Pointers returned before may be invalidated.
+    Value& insert(const Key& key, Value value) {
+        auto found = _index.find(key);
+        if (found != _index.end()) {
+            auto& slot = _slots[found->second];
+            slot.value = std::move(value);
+            slot.isReferenced = true;
+            return slot.value;
+        }
+
+        if (_slots.size() < _capacity) {
+            _index.emplace(key, _slots.size());
+            _slots.push_back({key, std::move(value), false});
+            return _slots.back().value;
+        }
+
+        while (_slots[_hand].isReferenced) {
+            _slots[_hand].isReferenced = false;
+            _hand = (_hand + 1) % _slots.size();
+        }
+        auto& victim = _slots[_hand];
+        _index.erase(victim.key);
+        ++_evictionsCount;
+
+        victim = {key, std::move(value), false};
+        _index.emplace(key, _hand);
+        _hand = (_hand + 1) % _slots.size();
+        return victim.value;
+    }
+
+    void erase(const Key& key) {
+        auto found = _index.find(key);
+        if (found == _index.end()) {
+            return;
+        }
+
+        const auto pos = found->second;
+        _index.erase(found);
+        if (pos + 1 != _slots.size()) {
+            _slots[pos] = std::move(_slots.back());
+            _index[_slots[pos].key] = pos;
+        }
+        _slots.pop_back();
+        if (_hand >= _slots.size()) {
+            _hand = 0;
+        }
+    }
+
+    void clear() {
+        _slots.clear();
+        _index.clear();
+        _hand = 0;
+    }
+
+private:
+    struct Slot {
+        Key key;
+        Value value;
+        bool isReferenced;
+    };
+
+    std::size_t _capacity;
+    std::vector<Slot> _slots;
+    // Position of the key's slot in `_slots`.
+    std::unordered_map<Key, std::size_t> _index;
+    std::size_t _hand = 0;
+    std::size_t _evictionsCount = 0;
+};
@@ -0,0 +1,254 @@
+#pragma once
+
+#include "metrics.hpp"
+
+#include <tgbot/net/HttpClient.h>
+#include <tgbot/net/HttpReqArg.h>
+#include <tgbot/net/Url.h>
+
+#include <curl/curl.h>
+
+#include <absl/time/clock.h>
+#include <absl/time/time.h>
+
+#include <fmt/format.h>
+
+#include <cstddef>
+#include <future>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// HttpClient that runs every request on one curl multi handle driven by its own thread. Requests from any number of
+// threads proceed concurrently over a shared pool of keep-alive connections, multiplexed over HTTP/2 when the server
+// supports it. makeRequest() still blocks its caller, as TgBot::Api expects, makeRequestAsync() does not.
+class CurlMultiHttpClient : public TgBot::HttpClient {
+public:
+    explicit CurlMultiHttpClient(std::size_t maxHostConnections = 8): _multi(curl_multi_init()) {
+        if (!_multi) {
+            throw std::runtime_error("curl_multi_init failed");
+        }
+        curl_multi_setopt(_multi, CURLMOPT_PIPELINING, CURLPIPE_MULTIPLEX);
+        curl_multi_setopt(_multi, CURLMOPT_MAX_HOST_CONNECTIONS, static_cast<long>(maxHostConnections));
+        curl_multi_setopt(_multi, CURLMOPT_MAXCONNECTS, static_cast<long>(maxHostConnections));
+
+        _thread = std::thread([this]() { work(); });
+    }
+
+    ~CurlMultiHttpClient() override {
+        {
+            std::unique_lock lk(_mutex);
+            _isRunning = false;
+        }
+        curl_multi_wakeup(_multi);
+        _thread.join();
+
+        for (auto& [easy, transfer] : _active) {
+            curl_multi_remove_handle(_multi, easy);
+            fail(*transfer, "HTTP client is stopped");
+            release(std::move(transfer));
+        }
+        for (auto& transfer : std::exchange(_submitted, {})) {
+            fail(*transfer, "HTTP client is stopped");
+            release(std::move(transfer));
+        }
+        for (auto* easy : _idleHandles) {
+            curl_easy_cleanup(easy);
+        }
+        curl_multi_cleanup(_multi);
+    }
+
+    CurlMultiHttpClient(const CurlMultiHttpClient&) = delete;
+    CurlMultiHttpClient& operator=(const CurlMultiHttpClient&) = delete;
+
+    std::string makeRequest(const TgBot::Url& url, const std::vector<TgBot::HttpReqArg>& args) const override {
+        return makeRequestAsync(url, args).get();
+    }
+
+    std::future<std::string> makeRequestAsync(const TgBot::Url& url,
+        const std::vector<TgBot::HttpReqArg>& args) const {
+        auto transfer = std::make_unique<Transfer>();
+        auto future = transfer->response.get_future();
+        transfer->start = absl::Now();
+
+        {
+            std::unique_lock lk(_mutex);
+            transfer->metrics = &methodMetrics(url.path.substr(url.path.rfind('/') + 1));
+            if (!_idleHandles.empty()) {
+                transfer->easy = _idleHandles.back();
+                _idleHandles.pop_back();
+            }
+        }
+        if (transfer->easy) {
+            curl_easy_reset(transfer->easy);
+        } else if (!(transfer->easy = curl_easy_init())) {
+            throw std::runtime_error("curl_easy_init failed");
+        }
+        setup(*transfer, url, args);
+
+        {
+            std::unique_lock lk(_mutex);
+            if (_isRunning) {
+                _submitted.push_back(std::move(transfer));
+            }
+        }
+        if (transfer) {
+            fail(*transfer, "HTTP client is stopped");
+            release(std::move(transfer));
+        } else {
+            curl_multi_wakeup(_multi);
+        }
+
+        return future;
+    }
+
+private:
+    struct MethodMetrics {
+        Histogram& duration;
+        Counter& errors;
+    };
+
+    struct Transfer {
+        CURL* easy = nullptr;
+        MethodMetrics* metrics = nullptr;
+        absl::Time start;
+        curl_mime* mime = nullptr;
+        std::string body;
+        std::promise<std::string> response;
+    };
+
+    static std::size_t writeBody(char* data, std::size_t size, std::size_t count, void* userData) {
+        static_cast<std::string*>(userData)->append(data, size * count);
+        return size * count;
+    }
+
+    void setup(Transfer& transfer, const TgBot::Url& url, const std::vector<TgBot::HttpReqArg>& args) const {
+        auto* easy = transfer.easy;
+
+        auto fullUrl = url.protocol + "://" + url.host + url.path;
+        if (args.empty()) {
+            fullUrl += "?" + url.query;
+        }
+        curl_easy_setopt(easy, CURLOPT_URL, fullUrl.c_str());
+        curl_easy_setopt(easy, CURLOPT_HTTP_VERSION, CURL_HTTP_VERSION_2TLS);
+        curl_easy_setopt(easy, CURLOPT_PIPEWAIT, 1L);
+        curl_easy_setopt(easy, CURLOPT_TCP_KEEPALIVE, 1L);
+        curl_easy_setopt(easy, CURLOPT_NOSIGNAL, 1L);
+        curl_easy_setopt(easy, CURLOPT_CONNECTTIMEOUT, static_cast<long>(_timeout));
+        curl_easy_setopt(easy, CURLOPT_TIMEOUT, static_cast<long>(_timeout));
+        curl_easy_setopt(easy, CURLOPT_WRITEFUNCTION, writeBody);
+        curl_easy_setopt(easy, CURLOPT_WRITEDATA, &transfer.body);
+
+        if (!args.empty()) {
+            transfer.mime = curl_mime_init(easy);
+            for (const auto& arg : args) {
+                auto* part = curl_mime_addpart(transfer.mime);
+                curl_mime_name(part, arg.name.c_str());
+                curl_mime_data(part, arg.value.c_str(), arg.value.size());
+                // Plain fields are sent without a type, as TgBot's own clients do.
+                if (arg.isFile) {
+                    curl_mime_type(part, arg.mimeType.c_str());
+                    curl_mime_filename(part, arg.fileName.c_str());
+                }
+            }
+            curl_easy_setopt(easy, CURLOPT_MIMEPOST, transfer.mime);
+        }
+    }
+
+    void work() {
+        std::vector<std::unique_ptr<Transfer>> submitted;
+        while (true) {
+            {
+                std::unique_lock lk(_mutex);
+                if (!_isRunning) {
+                    return;
+                }
+                submitted.swap(_submitted);
+            }
+
+            for (auto& transfer : submitted) {
+                auto* easy = transfer->easy;
+                if (auto code = curl_multi_add_handle(_multi, easy); code != CURLM_OK) {
+                    fail(*transfer, curl_multi_strerror(code));
+                    release(std::move(transfer));
+                    continue;
+                }
+                _active.emplace(easy, std::move(transfer));
+            }
+            submitted.clear();
+
+            int runningCount = 0;
+            curl_multi_perform(_multi, &runningCount);
+
+            int queuedCount = 0;
+            while (auto* info = curl_multi_info_read(_multi, &queuedCount)) {
+                if (info->msg != CURLMSG_DONE) {
+                    continue;
+                }
+
+                const auto result = info->data.result;
+                auto found = _active.find(info->easy_handle);
+                auto transfer = std::move(found->second);
+                _active.erase(found);
+                curl_multi_remove_handle(_multi, transfer->easy);
+
+                transfer->metrics->duration.record(absl::Now() - transfer->start);
+                if (result == CURLE_OK) {
+                    transfer->response.set_value(std::move(transfer->body));
+                } else {
+                    fail(*transfer, curl_easy_strerror(result));
+                }
+                release(std::move(transfer));
+            }
+
+            curl_multi_poll(_multi, nullptr, 0, 1000, nullptr);
+        }
+    }
+
+    // Must be called under _mutex.
+    MethodMetrics& methodMetrics(const std::string& method) const {
+        auto& metrics = _methodMetrics[method];
+        if (!metrics) {
+            const auto labels = fmt::format("method=\"{}\"", method);
+            metrics = std::make_unique<MethodMetrics>(MethodMetrics{
+                Metrics::get().histogram("wallet_bot_api_duration_seconds", labels),
+                Metrics::get().counter("wallet_bot_api_errors_total", labels),
+            });
+        }
+        return *metrics;
+    }
+
+    static void fail(Transfer& transfer, const std::string& error) {
+        transfer.metrics->errors.add();
+        transfer.response.set_exception(std::make_exception_ptr(std::runtime_error("curl error: " + error)));
+    }
+
+    // Finished handles are kept for reuse.
+    void release(std::unique_ptr<Transfer> transfer) const {
+        if (transfer->mime) {
+            curl_mime_free(transfer->mime);
+        }
+
+        std::unique_lock lk(_mutex);
+        _idleHandles.push_back(transfer->easy);
+    }
+
+private:
+    CURLM* _multi;
+    std::thread _thread;
+
+    mutable std::mutex _mutex;
+    mutable std::vector<std::unique_ptr<Transfer>> _submitted;
+    mutable std::vector<CURL*> _idleHandles;
+    mutable std::unordered_map<std::string, std::unique_ptr<MethodMetrics>> _methodMetrics;
+    bool _isRunning = true;
+
+    // Owned by the worker thread.
+    std::unordered_map<CURL*, std::unique_ptr<Transfer>> _active;
+};
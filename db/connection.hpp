@@ -0,0 +1,154 @@
+#pragma once
+
+#include "../metrics.hpp"
+
+#include <SQLiteCpp/SQLiteCpp.h>
+
+#include <absl/time/clock.h>
+#include <absl/time/time.h>
+
+#include <fmt/format.h>
+
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+class Connection;
+
+// How a query is expected to read its tables. The query plans test runs every SEARCH query the models prepare through
+// EXPLAIN QUERY PLAN and fails if SQLite falls back to a full scan.
+enum class QueryPlan {
+    SEARCH,
+    SCAN,
+};
+
+// Prepared statement borrowed from Connection's cache. Reset on destruction, so the next user rebinds and steps it
+// again without SQLite having to parse and plan the query. The time it was held, rows callbacks included, is recorded
+// to the statement kind's histogram.
+class CachedStatement {
+public:
+    CachedStatement(CachedStatement&& other) noexcept:
+        _statement(other._statement),
+        _busy(other._busy),
+        _owned(std::move(other._owned)),
+        _histogram(other._histogram),
+        _start(other._start) {
+        other._statement = nullptr;
+        other._busy = nullptr;
+    }
+    CachedStatement(const CachedStatement&) = delete;
+    CachedStatement& operator=(const CachedStatement&) = delete;
+    CachedStatement& operator=(CachedStatement&&) = delete;
+
+    ~CachedStatement() {
+        if (!_statement) {
+            return;
+        }
+        _histogram->record(absl::Now() - _start);
+        if (_owned) {
+            return;
+        }
+        _statement->tryReset();
+        _statement->clearBindings();
+        *_busy = false;
+    }
+
+    SQLite::Statement* operator->() const noexcept {
+        return _statement;
+    }
+
+    SQLite::Statement& operator*() const noexcept {
+        return *_statement;
+    }
+
+private:
+    friend class Connection;
+
+    CachedStatement(SQLite::Statement& statement, bool& busy, Histogram& histogram):
+        _statement(&statement), _busy(&busy), _histogram(&histogram), _start(absl::Now()) {
+        *_busy = true;
+    }
+
+    CachedStatement(std::unique_ptr<SQLite::Statement> owned, Histogram& histogram):
+        _statement(owned.get()),
+        _busy(nullptr),
+        _owned(std::move(owned)),
+        _histogram(&histogram),
+        _start(absl::Now()) {}
+
+    SQLite::Statement* _statement;
+    bool* _busy;
+    std::unique_ptr<SQLite::Statement> _owned;
+    Histogram* _histogram;
+    absl::Time _start;
+};
+
+class Connection: public SQLite::Database {
+public:
+    using SQLite::Database::Database;
+
+    Connection(const Connection&) = delete;
+    Connection& operator=(const Connection&) = delete;
+
+    // Statements are keyed by their SQL text, so queries must take all variable parts as `?` parameters.
+    CachedStatement prepare(const std::string& query, QueryPlan plan = QueryPlan::SEARCH) {
+        auto found = _statements.find(query);
+        if (found == _statements.end()) {
+            auto entry = std::make_unique<Entry>(Entry{SQLite::Statement(*this, query), false,
+                &Metrics::get().histogram("wallet_sql_duration_seconds", statementKindLabel(query)), plan});
+            found = _statements.emplace(query, std::move(entry)).first;
+        }
+
+        auto& entry = *found->second;
+        if (entry.busy) {
+            // Same query is already being stepped further up the stack, use a one-off statement.
+            return CachedStatement(std::make_unique<SQLite::Statement>(*this, query), *entry.histogram);
+        }
+
+        return CachedStatement(entry.statement, entry.busy, *entry.histogram);
+    }
+
+    // Every query prepared so far with its expected plan.
+    template<class Fn>
+    void forEachPrepared(Fn&& fn) const {
+        for (const auto& [query, entry] : _statements) {
+            fn(query, entry->plan);
+        }
+    }
+
+private:
+    struct Entry {
+        SQLite::Statement statement;
+        bool busy;
+        Histogram* histogram;
+        QueryPlan plan;
+    };
+
+    // `statement="SELECT Entries"`: the verb and the first table, which is enough to tell the bot's queries apart in
+    // metrics without putting whole SQL texts into labels.
+    static std::string statementKindLabel(std::string_view query) {
+        std::string_view verb;
+        std::string_view table;
+        std::string_view previous;
+        for (std::size_t pos = 0; pos < query.size() && table.empty();) {
+            const auto start = query.find_first_not_of(" \n\t(),;", pos);
+            if (start == std::string_view::npos) {
+                break;
+            }
+            pos = std::min(query.find_first_of(" \n\t(),;", start), query.size());
+            const auto word = query.substr(start, pos - start);
+
+            if (verb.empty()) {
+                verb = word;
+            } else if (previous == "FROM" || previous == "INTO" || previous == "UPDATE" || verb == "UPDATE") {
+                table = word;
+            }
+            previous = word;
+        }
+        return fmt::format("statement=\"{}{}{}\"", verb, table.empty() ? "" : " ", table);
+    }
+    // Declared after the base, so statements are finalized before the database handle is closed.
+    std::unordered_map<std::string, std::unique_ptr<Entry>> _statements;
+};
@@ -2,6 +2,7 @@
 
 #include "../utils.hpp"
 #include "wallet.hpp"
+#include "wallet_aggregates.hpp"
 #include "wallet_entry.hpp"
 
 #include <SQLiteCpp/SQLiteCpp.h>
@@ -11,17 +12,16 @@
 
 #include <fmt/format.h>
 
+#include <algorithm>
+#include <cstddef>
 #include <cstdint>
-
-static inline std::int64_t dateToInt(absl::CivilDay day) {
-    return day.day() + day.month() * 100 + day.year() * 10000;
-}
-
-static inline absl::CivilDay intToDate(std::int64_t dayInt) {
-    return absl::CivilDay(dayInt / 10000, (dayInt / 100) % 100, dayInt % 100);
-}
+#include <optional>
+#include <vector>
 
 struct DayReport {
+    // Longest range a report is built for, every day is a table row.
+    static constexpr std::size_t MAX_DAYS = 366;
+
     std::int64_t chatId;
     absl::CivilDay date;
     double dayExpenses;
@@ -51,75 +51,163 @@ struct DayReport {
             formatWithApostrophes(dayExpenses), dayColor(), formatWithApostrophes(dayBalance));
     }
 
-    static std::optional<DayReport> load(SQLite::Database& db, const Wallet& wallet, absl::CivilDay day) {
-        const auto nowDay = absl::ToCivilDay(absl::Now(), wallet.timeZone);
-        if (nowDay <= day) {
+    static std::optional<DayReport> load(Connection& db, WalletAggregates& aggregates, const Wallet& wallet,
+        absl::CivilDay day) {
+        auto reports = loadRange(db, aggregates, wallet, day, 1);
+        if (reports.empty() || reports.back().date != day) {
             return std::nullopt;
         }
+        return reports.back();
+    }
 
-        SQLite::Statement queryFirstWalletEntry(db,
-            fmt::format("SELECT MIN(ts) FROM Entries WHERE chat_id = {}", wallet.chatId));
+    // Reports for up to `daysCount` days ending with `lastDay`, ordered by date. Days before the first wallet entry and
+    // days not finished yet are skipped. Missing reports are materialized before reading.
+    static std::vector<DayReport> loadRange(Connection& db, WalletAggregates& aggregates, const Wallet& wallet,
+        absl::CivilDay lastDay, std::size_t daysCount) {
+        const auto firstWalletEntryDay = materialize(db, aggregates, wallet, lastDay);
+        return loadStoredRange(db, wallet, firstWalletEntryDay, lastDay, daysCount);
+    }
+
+    // Stores every missing report up to `lastDay`. Returns the first wallet entry day, nullopt for a wallet without
+    // entries. Needs a writable connection.
+    static std::optional<absl::CivilDay> materialize(Connection& db, WalletAggregates& aggregates,
+        const Wallet& wallet, absl::CivilDay lastDay) {
+        return materialize(db, aggregates, aggregates.get(db, wallet), wallet, lastDay);
+    }
 
-        if (!queryFirstWalletEntry.executeStep()) {
-            DayReport report;
-            report.chatId = wallet.chatId;
-            report.date = day;
-            report.dayLimit = wallet.dayLimit;
-            report.dayExpenses = 0;
-            report.dayBalance = report.dayLimit - report.dayExpenses;
+    // Same as materialize(), but leaves the aggregates cache as it is for wallets not in it, as the nightly pass over
+    // every wallet needs.
+    static std::optional<absl::CivilDay> materializeUncached(Connection& db, WalletAggregates& aggregates,
+        const Wallet& wallet, absl::CivilDay lastDay) {
+        return materialize(db, aggregates, aggregates.peek(db, wallet), wallet, lastDay);
+    }
 
-            return report;
+    // Reads reports stored by materialize(), can run on a read-only connection.
+    static std::vector<DayReport> loadStoredRange(Connection& db, const Wallet& wallet,
+        std::optional<absl::CivilDay> firstWalletEntryDay, absl::CivilDay lastDay, std::size_t daysCount) {
+        std::vector<DayReport> reports;
+
+        lastDay = std::min(lastDay, absl::ToCivilDay(absl::Now(), wallet.timeZone) - 1);
+        daysCount = std::min(daysCount, MAX_DAYS);
+        if (daysCount == 0) {
+            return reports;
+        }
+        auto firstDay = lastDay - (daysCount - 1);
+
+        if (!firstWalletEntryDay) {
+            for (auto day = firstDay; day <= lastDay; ++day) {
+                DayReport report;
+                report.chatId = wallet.chatId;
+                report.date = day;
+                report.dayLimit = wallet.dayLimit;
+                report.dayExpenses = 0;
+                report.dayBalance = report.dayLimit - report.dayExpenses;
+                reports.push_back(report);
+            }
+
+            return reports;
         }
 
-        const auto firstWalletEntryTs = queryFirstWalletEntry.getColumn(0).getInt64();
-        const auto firstDay = absl::ToCivilDay(absl::FromUnixSeconds(firstWalletEntryTs), wallet.timeZone);
+        firstDay = std::max(firstDay, *firstWalletEntryDay);
+        if (firstDay > lastDay) {
+            return reports;
+        }
+
+        auto query = db.prepare("SELECT * FROM DayReports WHERE chat_id = ? AND date >= ? AND date <= ? ORDER BY date");
+        query->bind(1, wallet.chatId);
+        query->bind(2, dateToInt(firstDay));
+        query->bind(3, dateToInt(lastDay));
+        while (query->executeStep()) {
+            reports.push_back(fromRow(*query));
+        }
 
-        return load(db, wallet, day, firstDay);
+        return reports;
     }
 
-    void save(SQLite::Database& db) {
-        db.exec(fmt::format("INSERT INTO DayReports VALUES({},{},{},{},{})", chatId, dateToInt(date), dayExpenses,
-            dayBalance, dayLimit));
+    void save(Connection& db) {
+        auto query = db.prepare("INSERT INTO DayReports VALUES(?, ?, ?, ?, ?)");
+        query->bind(1, chatId);
+        query->bind(2, dateToInt(date));
+        query->bind(3, dayExpenses);
+        query->bind(4, dayBalance);
+        query->bind(5, dayLimit);
+        query->exec();
     }
 
 private:
-    static std::optional<DayReport> load(SQLite::Database& db, const Wallet& wallet, absl::CivilDay day,
-        absl::CivilDay firstWalletEntryDay) {
+    static std::optional<absl::CivilDay> materialize(Connection& db, WalletAggregates& aggregates,
+        const WalletAggregate& aggregate, const Wallet& wallet, absl::CivilDay lastDay) {
+        lastDay = std::min(lastDay, absl::ToCivilDay(absl::Now(), wallet.timeZone) - 1);
 
-        if (day < firstWalletEntryDay) {
+        if (!aggregate.firstEntryTime) {
             return std::nullopt;
         }
 
-        SQLite::Statement query(db,
-            fmt::format("SELECT * FROM DayReports WHERE chat_id = {} AND date = {}", wallet.chatId, dateToInt(day)));
+        const auto firstWalletEntryDay = absl::ToCivilDay(*aggregate.firstEntryTime, wallet.timeZone);
+        if (firstWalletEntryDay <= lastDay && (!aggregate.lastClosedDay || *aggregate.lastClosedDay < lastDay)) {
+            backfill(db, aggregates, aggregate, wallet, firstWalletEntryDay, lastDay);
+        }
+
+        return firstWalletEntryDay;
+    }
+
+    static DayReport fromRow(const SQLite::Statement& query) {
+        DayReport report;
+        report.chatId = query.getColumn(0).getInt64();
+        report.date = intToDate(query.getColumn(1).getInt64());
+        report.dayExpenses = query.getColumn(2).getDouble();
+        report.dayBalance = query.getColumn(3).getDouble();
+        report.dayLimit = query.getColumn(4).getDouble();
+
+        return report;
+    }
 
-        if (query.executeStep()) {
-            DayReport report;
-            report.chatId = query.getColumn(0).getInt64();
-            report.date = intToDate(query.getColumn(1).getInt64());
-            report.dayExpenses = query.getColumn(2).getDouble();
-            report.dayBalance = query.getColumn(3).getDouble();
-            report.dayLimit = query.getColumn(4).getDouble();
+    // Materializes reports for every day after the last stored one up to `lastDay` in one forward pass: expenses of
+    // the whole gap come from a single range scan and all rows are written under one savepoint. The last stored report
+    // is looked up only when the aggregate doesn't remember it yet.
+    static void backfill(Connection& db, WalletAggregates& aggregates, const WalletAggregate& aggregate,
+        const Wallet& wallet, absl::CivilDay firstWalletEntryDay, absl::CivilDay lastDay) {
+        auto firstMissingDay = firstWalletEntryDay;
+        std::optional<double> prevBalance;
+        if (aggregate.lastClosedDay) {
+            prevBalance = aggregate.lastClosedDayBalance;
+            firstMissingDay = std::max(firstMissingDay, *aggregate.lastClosedDay + 1);
+        } else {
+            auto query = db.prepare(
+                "SELECT date, day_balance FROM DayReports WHERE chat_id = ? AND date <= ? ORDER BY date DESC LIMIT 1");
+            query->bind(1, wallet.chatId);
+            query->bind(2, dateToInt(lastDay));
+            if (query->executeStep()) {
+                const auto lastStoredDay = intToDate(query->getColumn(0).getInt64());
+                prevBalance = query->getColumn(1).getDouble();
+                aggregates.onDayClosed(wallet.chatId, lastStoredDay, *prevBalance);
+                if (lastStoredDay >= lastDay) {
+                    return;
+                }
+                firstMissingDay = std::max(firstMissingDay, lastStoredDay + 1);
+            }
+        }
 
-            return report;
+        if (firstMissingDay > lastDay) {
+            return;
         }
 
-        auto dayBeforeReport = load(db, wallet, day - 1, firstWalletEntryDay);
+        const auto amounts = WalletEntry::getAmountsByDays(db, wallet, firstMissingDay, lastDay - firstMissingDay + 1);
 
+        SQLite::Savepoint savepoint(db, "DayReportsBackfill");
         DayReport report;
         report.chatId = wallet.chatId;
-        report.date = day;
-        report.dayExpenses = WalletEntry::getDayAmountSum(db, wallet, day).amount;
         report.dayLimit = wallet.dayLimit;
+        for (std::size_t i = 0; i != amounts.size(); ++i) {
+            report.date = firstMissingDay + i;
+            report.dayExpenses = amounts[i];
+            report.dayBalance = prevBalance.value_or(0) + report.dayLimit - report.dayExpenses;
+            report.save(db);
 
-        if (!dayBeforeReport) {
-            report.dayBalance = report.dayLimit - report.dayExpenses;
-        } else {
-            report.dayBalance = dayBeforeReport->dayBalance + report.dayLimit - report.dayExpenses;
+            prevBalance = report.dayBalance;
         }
+        savepoint.release();
 
-        report.save(db);
-
-        return report;
+        aggregates.onDayClosed(wallet.chatId, report.date, report.dayBalance);
     }
 };
@@ -0,0 +1,148 @@
+#pragma once
+
+#include "../clock_map.hpp"
+#include "../utils.hpp"
+#include "connection.hpp"
+#include "wallet.hpp"
+
+#include <absl/time/time.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+// Binary indexed tree over a growing sequence of values: appending, changing a value and summing a prefix are all
+// O(log n).
+class FenwickTree {
+public:
+    std::size_t size() const noexcept {
+        return _tree.size() - 1;
+    }
+
+    void push_back(double value) {
+        // Node n covers values (n - lowbit(n), n], all of them but the new one are already in the tree.
+        const auto n = _tree.size();
+        _tree.push_back(value + prefix(n - 1) - prefix(n - (n & -n)));
+    }
+
+    void add(std::size_t index, double delta) {
+        for (auto n = index + 1; n < _tree.size(); n += n & -n) {
+            _tree[n] += delta;
+        }
+    }
+
+    // Sum of the first `count` values.
+    double prefix(std::size_t count) const {
+        double sum = 0;
+        for (auto n = std::min(count, size()); n != 0; n -= n & -n) {
+            sum += _tree[n];
+        }
+        return sum;
+    }
+
+    std::size_t bytes() const noexcept {
+        return _tree.capacity() * sizeof(_tree[0]);
+    }
+
+private:
+    // 1-based, _tree[0] is unused.
+    std::vector<double> _tree = {0};
+};
+
+// Expenses and limits of every closed day of a wallet, indexed by day, as stored in DayReports. Any range total and
+// the balance as of any day, which is the running sum of limit minus expenses, take O(log days).
+struct DaySums {
+    absl::CivilDay firstDay;
+    FenwickTree expenses;
+    FenwickTree limits;
+
+    std::size_t daysCount() const noexcept {
+        return expenses.size();
+    }
+
+    // Last indexed day, firstDay - 1 when there are none.
+    absl::CivilDay lastDay() const noexcept {
+        return firstDay + static_cast<std::int64_t>(daysCount()) - 1;
+    }
+
+    double expensesSum(absl::CivilDay first, absl::CivilDay last) const {
+        return rangeSum(expenses, first, last);
+    }
+
+    double limitsSum(absl::CivilDay first, absl::CivilDay last) const {
+        return rangeSum(limits, first, last);
+    }
+
+    double balance(absl::CivilDay day) const {
+        return limitsSum(firstDay, day) - expensesSum(firstDay, day);
+    }
+
+    // Days between the last indexed one and `day` had no report and count as zero.
+    void append(absl::CivilDay day, double dayExpenses, double dayLimit) {
+        if (daysCount() == 0) {
+            firstDay = day;
+        }
+        if (day <= lastDay()) {
+            const auto index = static_cast<std::size_t>(day - firstDay);
+            expenses.add(index, dayExpenses);
+            limits.add(index, dayLimit);
+            return;
+        }
+        while (lastDay() + 1 < day) {
+            expenses.push_back(0);
+            limits.push_back(0);
+        }
+        expenses.push_back(dayExpenses);
+        limits.push_back(dayLimit);
+    }
+
+    // Appends stored reports after the last indexed day.
+    void extend(Connection& db, std::int64_t chatId) {
+        auto query = db.prepare("SELECT date, day_expenses, day_limit FROM DayReports WHERE chat_id = ? AND date > ? "
+                                "ORDER BY date");
+        query->bind(1, chatId);
+        query->bind(2, daysCount() == 0 ? 0 : dateToInt(lastDay()));
+        while (query->executeStep()) {
+            append(intToDate(query->getColumn(0).getInt64()), query->getColumn(1).getDouble(),
+                query->getColumn(2).getDouble());
+        }
+    }
+
+private:
+    double rangeSum(const FenwickTree& tree, absl::CivilDay first, absl::CivilDay last) const {
+        first = std::max(first, firstDay);
+        last = std::min(last, lastDay());
+        if (first > last) {
+            return 0;
+        }
+        return tree.prefix(last - firstDay + 1) - tree.prefix(first - firstDay);
+    }
+};
+
+// Per wallet DaySums, built from DayReports on first use and caught up with reports materialized since. The reports
+// table stays the only persisted form, it already holds one row per day. At most `capacity` wallets are kept, the
+// ones not used lately are evicted first. Not synchronized, used under the storage writer's lock like WalletAggregates,
+// and must be cleared after reports it may have read are rolled back.
+class DaySumsIndex {
+public:
+    explicit DaySumsIndex(std::size_t capacity = 65536): _wallets(capacity) {}
+
+    // Index of every report stored up to now, materialize them first to cover the last closed day.
+    const DaySums& get(Connection& db, std::int64_t chatId) {
+        auto* sums = _wallets.find(chatId);
+        if (!sums) {
+            sums = &_wallets.insert(chatId, DaySums{});
+        }
+        sums->extend(db, chatId);
+        return *sums;
+    }
+
+    void clear() {
+        _wallets.clear();
+    }
+
+private:
+    ClockMap<std::int64_t, DaySums> _wallets;
+};
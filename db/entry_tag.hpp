@@ -1,6 +1,7 @@
 #pragma once
 
 #include "../utils.hpp"
+#include "tag_day_totals.hpp"
 #include "wallet.hpp"
 #include "wallet_entry.hpp"
 
@@ -17,27 +18,57 @@ struct EntryTag {
     std::int64_t entryId;
     std::int64_t tagId;
 
-    bool save(SQLite::Database& db) const {
-        SQLite::Statement checkQery(db, fmt::format(R"(
-    SELECT * FROM Entries
+    // `chatId` and `timeZone` are of the wallet the tag is added from. An entry of another chat isn't tagged, as for an
+    // unknown entry or tag false is returned.
+    bool save(Connection& db, std::int64_t chatId, const absl::TimeZone& timeZone) const {
+        absl::CivilDay day;
+        double amount;
+        bool wasTagged;
+        bool hasTag;
+        {
+            auto checkQery = db.prepare(R"(
+    SELECT Entries.ts, Entries.amount,
+        EXISTS(SELECT 1 FROM EntryTags WHERE EntryTags.entry_id=Entries.id),
+        EXISTS(SELECT 1 FROM EntryTags WHERE EntryTags.entry_id=Entries.id AND EntryTags.tag_id=Tags.id)
+    FROM Entries
     INNER JOIN Tags ON Entries.chat_id=Tags.chat_id
-    WHERE Entries.id={} AND Tags.id={};)",
-                                            entryId, tagId));
+    WHERE Entries.id=? AND Tags.id=? AND Entries.chat_id=?;)");
+            checkQery->bind(1, entryId);
+            checkQery->bind(2, tagId);
+            checkQery->bind(3, chatId);
 
-        if (checkQery.executeStep()) {
-            db.exec(fmt::format("INSERT OR REPLACE INTO EntryTags VALUES({}, {})", entryId, tagId));
+            if (!checkQery->executeStep()) {
+                return false;
+            }
+            day = absl::ToCivilDay(absl::FromUnixSeconds(checkQery->getColumn(0).getInt64()), timeZone);
+            amount = checkQery->getColumn(1).getDouble();
+            wasTagged = checkQery->getColumn(2).getInt() != 0;
+            hasTag = checkQery->getColumn(3).getInt() != 0;
+        }
+        if (hasTag) {
             return true;
         }
-        return false;
+
+        auto query = db.prepare("INSERT INTO EntryTags VALUES(?, ?)");
+        query->bind(1, entryId);
+        query->bind(2, tagId);
+        query->exec();
+
+        TagDayTotals::add(db, chatId, day, tagId, amount);
+        if (!wasTagged) {
+            TagDayTotals::add(db, chatId, day, TagDayTotals::UNTAGGED, -amount);
+        }
+        return true;
     }
 
     template<class Fn>
-    static void loadForEach(SQLite::Database& db, std::int64_t entryId, Fn&& fn) {
-        SQLite::Statement query(db, fmt::format("SELECT * FROM EntryTags WHERE entry_id = {}", entryId));
+    static void loadForEach(Connection& db, std::int64_t entryId, Fn&& fn) {
+        auto query = db.prepare("SELECT * FROM EntryTags WHERE entry_id = ?");
+        query->bind(1, entryId);
         EntryTag tag;
-        while (query.executeStep()) {
-            tag.entryId = query.getColumn(0).getInt64();
-            tag.tagId = query.getColumn(1).getInt64();
+        while (query->executeStep()) {
+            tag.entryId = query->getColumn(0).getInt64();
+            tag.tagId = query->getColumn(1).getInt64();
 
             fn(std::move(tag));
         }
@@ -0,0 +1,144 @@
+#pragma once
+
+#include "connection.hpp"
+
+#include <SQLiteCpp/SQLiteCpp.h>
+
+#include <absl/time/clock.h>
+#include <absl/time/time.h>
+
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Collects write operations from many handlers into one transaction, so a burst of expenses pays for one commit instead
+// of one per message. A batch is flushed when it reaches `maxBatchSize` operations or `maxDelay` after its first
+// operation arrived. Futures returned by submit() are ready only once the batch is committed.
+class GroupCommitWriter {
+public:
+    using Operation = std::function<void(Connection& db)>;
+
+    // `dbMutex` is held while a batch is written, it must be the same mutex other users of `db` lock. `onRollback` is
+    // called under it when any work of a batch was rolled back, so in-memory state updated by operations can be reset.
+    GroupCommitWriter(Connection& db, std::mutex& dbMutex, std::size_t maxBatchSize, absl::Duration maxDelay,
+        std::function<void()> onRollback = {}):
+        _db(db),
+        _dbMutex(dbMutex),
+        _maxBatchSize(maxBatchSize),
+        _maxDelay(maxDelay),
+        _onRollback(std::move(onRollback)) {
+        _thread = std::thread([this]() { work(); });
+    }
+
+    ~GroupCommitWriter() {
+        {
+            std::unique_lock lk(_mutex);
+            _isRunning = false;
+        }
+        _cond.notify_all();
+        _thread.join();
+    }
+
+    std::future<void> submit(Operation op) {
+        std::unique_lock lk(_mutex);
+        if (_pending.empty()) {
+            _batchDeadline = absl::Now() + _maxDelay;
+        }
+        _pending.push_back({std::move(op), {}});
+        auto future = _pending.back().done.get_future();
+
+        if (_pending.size() == 1 || _pending.size() >= _maxBatchSize) {
+            _cond.notify_one();
+        }
+
+        return future;
+    }
+
+private:
+    struct Pending {
+        Operation op;
+        std::promise<void> done;
+    };
+
+    void work() {
+        std::unique_lock lk(_mutex);
+        while (true) {
+            _cond.wait(lk, [&]() { return !_pending.empty() || !_isRunning; });
+            _cond.wait_for(lk, absl::ToChronoMicroseconds(_batchDeadline - absl::Now()),
+                [&]() { return _pending.size() >= _maxBatchSize || !_isRunning; });
+
+            std::vector<Pending> batch;
+            batch.swap(_pending);
+            lk.unlock();
+
+            if (!batch.empty()) {
+                flush(batch);
+            }
+
+            lk.lock();
+            if (!_isRunning && _pending.empty()) {
+                return;
+            }
+        }
+    }
+
+    void flush(std::vector<Pending>& batch) {
+        std::vector<std::exception_ptr> errors(batch.size());
+        std::exception_ptr commitError;
+        bool isRolledBack = false;
+        {
+            std::unique_lock lk(_dbMutex);
+            try {
+                SQLite::Transaction tr(_db);
+                for (std::size_t i = 0; i != batch.size(); ++i) {
+                    // Failed operation is rolled back alone, the rest of the batch is still committed.
+                    SQLite::Savepoint savepoint(_db, "GroupCommitOperation");
+                    try {
+                        batch[i].op(_db);
+                        savepoint.release();
+                    } catch (...) {
+                        errors[i] = std::current_exception();
+                        isRolledBack = true;
+                    }
+                }
+                tr.commit();
+            } catch (...) {
+                commitError = std::current_exception();
+                isRolledBack = true;
+            }
+
+            if (isRolledBack && _onRollback) {
+                _onRollback();
+            }
+        }
+
+        for (std::size_t i = 0; i != batch.size(); ++i) {
+            if (commitError) {
+                batch[i].done.set_exception(commitError);
+            } else if (errors[i]) {
+                batch[i].done.set_exception(errors[i]);
+            } else {
+                batch[i].done.set_value();
+            }
+        }
+    }
+
+private:
+    Connection& _db;
+    std::mutex& _dbMutex;
+    std::size_t _maxBatchSize;
+    absl::Duration _maxDelay;
+    std::function<void()> _onRollback;
+
+    std::mutex _mutex;
+    std::condition_variable _cond;
+    std::vector<Pending> _pending;
+    absl::Time _batchDeadline;
+    bool _isRunning = true;
+    std::thread _thread;
+};
@@ -0,0 +1,350 @@
+#pragma once
+
+#include "../metrics.hpp"
+#include "connection.hpp"
+#include "storage.hpp"
+#include "tag_day_totals.hpp"
+#include "wallet.hpp"
+#include "wallet_entry.hpp"
+
+#include <absl/time/clock.h>
+#include <absl/time/time.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <list>
+#include <mutex>
+#include <optional>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// Entries of one wallet since `start`, as columns sorted by ts. An entry's first tag is in `tagIds`, UNTAGGED if it
+// has none; further tags are rare and kept in `extraTags`.
+struct WalletColumns {
+    struct ExtraTag {
+        std::int64_t entryId;
+        std::int64_t ts;
+        double amount;
+        std::int64_t tagId;
+    };
+
+    std::int64_t start = 0;
+    std::vector<std::int64_t> ids;
+    std::vector<std::int64_t> ts;
+    std::vector<double> amounts;
+    std::vector<std::int64_t> tagIds;
+    std::vector<ExtraTag> extraTags;
+
+    static WalletColumns load(Connection& db, std::int64_t chatId, std::int64_t start) {
+        WalletColumns columns;
+        columns.start = start;
+
+        // The clustered key already gives this order, ORDER BY only makes it a guarantee.
+        auto query = db.prepare("SELECT id, ts, amount, tag_id FROM Entries "
+                                "LEFT JOIN EntryTags ON Entries.id = EntryTags.entry_id WHERE chat_id = ? AND ts >= ? "
+                                "ORDER BY Entries.ts, Entries.id");
+        query->bind(1, chatId);
+        query->bind(2, start);
+        while (query->executeStep()) {
+            const auto id = query->getColumn(0).getInt64();
+            const auto tagId = query->isColumnNull(3) ? TagDayTotals::UNTAGGED : query->getColumn(3).getInt64();
+            // Rows are ordered by entry, so all tags of an entry are adjacent.
+            if (!columns.ids.empty() && columns.ids.back() == id) {
+                columns.extraTags.push_back({id, columns.ts.back(), columns.amounts.back(), tagId});
+                continue;
+            }
+            columns.ids.push_back(id);
+            columns.ts.push_back(query->getColumn(1).getInt64());
+            columns.amounts.push_back(query->getColumn(2).getDouble());
+            columns.tagIds.push_back(tagId);
+        }
+
+        return columns;
+    }
+
+    void append(std::int64_t id, std::int64_t time, double amount) {
+        // Messages arrive almost in order, so this is nearly always the end.
+        const auto pos = std::upper_bound(ts.begin(), ts.end(), time) - ts.begin();
+        ids.insert(ids.begin() + pos, id);
+        ts.insert(ts.begin() + pos, time);
+        amounts.insert(amounts.begin() + pos, amount);
+        tagIds.insert(tagIds.begin() + pos, TagDayTotals::UNTAGGED);
+    }
+
+    bool contains(std::int64_t entryId) const {
+        return std::find(ids.rbegin(), ids.rend(), entryId) != ids.rend();
+    }
+
+    void tag(std::int64_t entryId, std::int64_t tagId) {
+        const auto found = std::find(ids.rbegin(), ids.rend(), entryId);
+        if (found == ids.rend()) {
+            return;
+        }
+        const auto row = std::distance(ids.begin(), found.base()) - 1;
+
+        if (tagIds[row] == TagDayTotals::UNTAGGED) {
+            tagIds[row] = tagId;
+            return;
+        }
+        if (tagIds[row] == tagId || std::any_of(extraTags.begin(), extraTags.end(), [&](const ExtraTag& extra) {
+                return extra.entryId == entryId && extra.tagId == tagId;
+            })) {
+            return;
+        }
+        extraTags.push_back({entryId, ts[row], amounts[row], tagId});
+    }
+
+    std::size_t bytes() const {
+        return sizeof(*this) + ids.capacity() * sizeof(ids[0]) + ts.capacity() * sizeof(ts[0]) +
+               amounts.capacity() * sizeof(amounts[0]) + tagIds.capacity() * sizeof(tagIds[0]) +
+               extraTags.capacity() * sizeof(extraTags[0]);
+    }
+
+    // First row with ts not before `time`.
+    std::size_t row(std::int64_t time) const {
+        return std::lower_bound(ts.begin(), ts.end(), time) - ts.begin();
+    }
+
+    // Four independent accumulators let the compiler keep the loop in SIMD registers without reassociating a single
+    // floating point sum, which it may not do without -ffast-math.
+    double sum(std::size_t firstRow, std::size_t lastRow) const {
+        const double* values = amounts.data();
+        double acc[4] = {};
+        auto i = firstRow;
+        for (; i + 4 <= lastRow; i += 4) {
+            acc[0] += values[i];
+            acc[1] += values[i + 1];
+            acc[2] += values[i + 2];
+            acc[3] += values[i + 3];
+        }
+        for (; i != lastRow; ++i) {
+            acc[0] += values[i];
+        }
+        return (acc[0] + acc[1]) + (acc[2] + acc[3]);
+    }
+};
+
+// Optional in-memory copy of the last `days` days of entries of recently used wallets, so day and tag sums are scans
+// over contiguous arrays instead of statement steps. SQLite stays the source of truth: a wallet is loaded from a read
+// snapshot on first use, committed saves and tags are applied on top, and least recently used wallets are dropped once
+// the columns take more than `maxBytes`. Has its own lock, which a load doesn't hold: changes reported while a wallet
+// is loading are kept and replayed on the loaded columns, so one committed after the snapshot was taken isn't lost.
+class HotWindow {
+public:
+    HotWindow(std::size_t days, std::size_t maxBytes): _days(days), _maxBytes(maxBytes) {}
+
+    bool isEnabled() const noexcept {
+        return _days != 0;
+    }
+
+    std::size_t bytes() const {
+        std::unique_lock lk(_mutex);
+        return _bytes;
+    }
+
+    // Must be called after the entry is committed.
+    void onEntrySaved(const WalletEntry& entry) {
+        const auto ts = absl::ToUnixSeconds(entry.time);
+        std::unique_lock lk(_mutex);
+        if (auto loading = _loading.find(entry.chatId); loading != _loading.end()) {
+            loading->second.push_back({entry.id, ts, entry.amount, std::nullopt});
+            return;
+        }
+
+        auto found = _wallets.find(entry.chatId);
+        if (found == _wallets.end()) {
+            return;
+        }
+
+        auto& wallet = found->second;
+        if (ts < wallet.columns.start) {
+            return;
+        }
+        resize(wallet, [&]() { wallet.columns.append(entry.id, ts, entry.amount); });
+        touch(wallet);
+        evict();
+    }
+
+    // Must be called after the tag is committed.
+    void onEntryTagged(std::int64_t chatId, std::int64_t entryId, std::int64_t tagId) {
+        std::unique_lock lk(_mutex);
+        if (auto loading = _loading.find(chatId); loading != _loading.end()) {
+            loading->second.push_back({entryId, 0, 0, tagId});
+            return;
+        }
+
+        auto found = _wallets.find(chatId);
+        if (found == _wallets.end()) {
+            return;
+        }
+
+        auto& wallet = found->second;
+        resize(wallet, [&]() { wallet.columns.tag(entryId, tagId); });
+    }
+
+    // Same as WalletEntry::getAmountsByDays, nullopt if the days start before the window.
+    std::optional<std::vector<double>> amountsByDays(Storage& storage, const Wallet& wallet, absl::CivilDay firstDay,
+        std::size_t daysCount) {
+        const auto first = absl::ToUnixSeconds(absl::FromCivil(firstDay, wallet.timeZone));
+        return withColumns(storage, wallet, first, [&](const WalletColumns& columns) {
+            std::vector<double> amounts(daysCount, 0);
+            auto dayStart = columns.row(first);
+            for (std::size_t i = 0; i != daysCount; ++i) {
+                const auto dayEnd =
+                    columns.row(absl::ToUnixSeconds(absl::FromCivil(firstDay + (i + 1), wallet.timeZone)));
+                amounts[i] = columns.sum(dayStart, dayEnd);
+                dayStart = dayEnd;
+            }
+
+            return amounts;
+        });
+    }
+
+    // Same as WalletEntry::getReportByTags, nullopt if the days start before the window.
+    std::optional<WalletEntry::TagsReport> reportByTags(Storage& storage, const Wallet& wallet, std::size_t daysCount) {
+        const auto today = absl::ToCivilDay(absl::Now(), wallet.timeZone);
+        const auto first = absl::ToUnixSeconds(absl::FromCivil(today - daysCount, wallet.timeZone));
+        const auto last = absl::ToUnixSeconds(absl::FromCivil(today + 1, wallet.timeZone));
+        return withColumns(storage, wallet, first, [&](const WalletColumns& columns) {
+            WalletEntry::TagsReport report{};
+            const auto firstRow = columns.row(first);
+            const auto lastRow = columns.row(last);
+            report.total = columns.sum(firstRow, lastRow);
+            for (auto i = firstRow; i != lastRow; ++i) {
+                if (columns.tagIds[i] == TagDayTotals::UNTAGGED) {
+                    report.withoutTags += columns.amounts[i];
+                } else {
+                    report.byTags[columns.tagIds[i]] += columns.amounts[i];
+                }
+            }
+            for (const auto& extra : columns.extraTags) {
+                if (extra.ts >= first && extra.ts < last) {
+                    report.total += extra.amount;
+                    report.byTags[extra.tagId] += extra.amount;
+                }
+            }
+
+            return report;
+        });
+    }
+
+private:
+    struct HotWallet {
+        WalletColumns columns;
+        std::size_t bytes;
+        // Position in `_lru`.
+        std::list<std::int64_t>::iterator lruPos;
+    };
+
+    // Save or tag reported while the wallet is loading.
+    struct PendingChange {
+        std::int64_t entryId;
+        std::int64_t ts;
+        double amount;
+        // Set for a tag, the other fields are of a saved entry otherwise.
+        std::optional<std::int64_t> tagId;
+    };
+
+    // Result of `fn` on columns covering `first`, loaded if needed. nullopt when the window doesn't reach back to
+    // `first` or another thread is loading the wallet, the caller reads from SQLite then.
+    template<class Fn>
+    auto withColumns(Storage& storage, const Wallet& wallet, std::int64_t first, Fn&& fn)
+        -> std::optional<decltype(fn(std::declval<const WalletColumns&>()))> {
+        if (!isEnabled()) {
+            return std::nullopt;
+        }
+
+        std::unique_lock lk(_mutex);
+        auto found = _wallets.find(wallet.chatId);
+        if (found == _wallets.end()) {
+            const auto today = absl::ToCivilDay(absl::Now(), wallet.timeZone);
+            const auto start = absl::ToUnixSeconds(absl::FromCivil(today - _days, wallet.timeZone));
+            if (first < start || _loading.count(wallet.chatId)) {
+                return std::nullopt;
+            }
+            found = load(lk, storage, wallet.chatId, start);
+        } else if (first < found->second.columns.start) {
+            return std::nullopt;
+        } else {
+            touch(found->second);
+        }
+
+        return fn(found->second.columns);
+    }
+
+    // The snapshot is taken after the wallet is marked as loading, so every change it misses is kept in `_loading`.
+    std::unordered_map<std::int64_t, HotWallet>::iterator load(std::unique_lock<std::mutex>& lk, Storage& storage,
+        std::int64_t chatId, std::int64_t start) {
+        _loading.emplace(chatId, std::vector<PendingChange>{});
+        lk.unlock();
+
+        WalletColumns columns;
+        try {
+            columns = WalletColumns::load(*storage.read(), chatId, start);
+        } catch (...) {
+            lk.lock();
+            _loading.erase(chatId);
+            throw;
+        }
+
+        lk.lock();
+        auto pending = std::move(_loading.at(chatId));
+        _loading.erase(chatId);
+        for (const auto& change : pending) {
+            if (change.tagId) {
+                columns.tag(change.entryId, *change.tagId);
+            } else if (change.ts >= start && !columns.contains(change.entryId)) {
+                // Saves committed before the snapshot are in it already.
+                columns.append(change.entryId, change.ts, change.amount);
+            }
+        }
+
+        _loads.add();
+        _lru.push_front(chatId);
+        const auto bytes = columns.bytes();
+        auto loaded = _wallets.emplace(chatId, HotWallet{std::move(columns), bytes, _lru.begin()}).first;
+        _bytes += bytes;
+        evict();
+
+        return loaded;
+    }
+
+    template<class Fn>
+    void resize(HotWallet& wallet, Fn&& fn) {
+        fn();
+        _bytes -= wallet.bytes;
+        wallet.bytes = wallet.columns.bytes();
+        _bytes += wallet.bytes;
+    }
+
+    void touch(HotWallet& wallet) {
+        _lru.splice(_lru.begin(), _lru, wallet.lruPos);
+    }
+
+    // Drops least recently used wallets until the window fits, or only the last used one is left.
+    void evict() {
+        while (_bytes > _maxBytes && _lru.size() > 1) {
+            auto victim = _wallets.find(_lru.back());
+            _bytes -= victim->second.bytes;
+            _wallets.erase(victim);
+            _lru.pop_back();
+            _evictions.add();
+        }
+    }
+
+    std::size_t _days;
+    std::size_t _maxBytes;
+
+    mutable std::mutex _mutex;
+    std::size_t _bytes = 0;
+    std::unordered_map<std::int64_t, HotWallet> _wallets;
+    // Chat ids, most recently used first.
+    std::list<std::int64_t> _lru;
+    std::unordered_map<std::int64_t, std::vector<PendingChange>> _loading;
+
+    Counter& _loads = Metrics::get().counter("wallet_hot_window_loads_total");
+    Counter& _evictions = Metrics::get().counter("wallet_hot_window_evictions_total");
+};
@@ -0,0 +1,206 @@
+#pragma once
+
+#include "../utils.hpp"
+#include "connection.hpp"
+
+#include <SQLiteCpp/SQLiteCpp.h>
+
+#include <absl/strings/str_split.h>
+#include <absl/strings/strip.h>
+
+#include <fmt/format.h>
+
+#include <condition_variable>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <vector>
+
+// Connection settings, read from an optional `storage.conf` next to the database. Every line is `key=value`, missing
+// keys keep their defaults:
+//     synchronous=NORMAL
+//     mmap_size=268435456
+//     cache_size=-16000
+//     readers=4
+//     busy_timeout=5000
+//     group_commit_size=64
+//     group_commit_delay_ms=5
+//     hot_window_days=90
+//     hot_window_max_bytes=67108864
+//     wallet_cache_size=65536
+struct StorageConfig {
+    std::string synchronous = "NORMAL";
+    std::int64_t mmapSize = 256 * 1024 * 1024;
+    // Negative value is in KiB, as for PRAGMA cache_size.
+    std::int64_t cacheSize = -16000;
+    std::size_t readersCount = 4;
+    int busyTimeoutMs = 5000;
+    std::size_t groupCommitSize = 64;
+    std::int64_t groupCommitDelayMs = 5;
+    // Days of entries kept in memory per recently used wallet, 0 disables the hot window.
+    std::size_t hotWindowDays = 90;
+    std::size_t hotWindowMaxBytes = 64 * 1024 * 1024;
+    // Wallets, their aggregates and day sums kept in memory, evicted ones are read again from the database on next use.
+    std::size_t walletCacheSize = 65536;
+
+    static StorageConfig load(const std::filesystem::path& rootDir) {
+        StorageConfig config;
+
+        std::ifstream file(rootDir / "storage.conf");
+        std::string line;
+        while (std::getline(file, line)) {
+            std::pair<std::string_view, std::string_view> kv = absl::StrSplit(line, absl::MaxSplits('=', 1));
+            const auto key = absl::StripAsciiWhitespace(kv.first);
+            const auto value = absl::StripAsciiWhitespace(kv.second);
+
+            if (key == "synchronous") {
+                if (value == "OFF" || value == "NORMAL" || value == "FULL" || value == "EXTRA") {
+                    config.synchronous = value;
+                }
+            } else if (key == "mmap_size") {
+                config.mmapSize = strToT<std::int64_t>(value).value_or(config.mmapSize);
+            } else if (key == "cache_size") {
+                config.cacheSize = strToT<std::int64_t>(value).value_or(config.cacheSize);
+            } else if (key == "readers") {
+                config.readersCount =
+                    std::max<std::size_t>(1, strToT<std::size_t>(value).value_or(config.readersCount));
+            } else if (key == "busy_timeout") {
+                config.busyTimeoutMs = strToT<int>(value).value_or(config.busyTimeoutMs);
+            } else if (key == "group_commit_size") {
+                config.groupCommitSize =
+                    std::max<std::size_t>(1, strToT<std::size_t>(value).value_or(config.groupCommitSize));
+            } else if (key == "group_commit_delay_ms") {
+                config.groupCommitDelayMs = strToT<std::int64_t>(value).value_or(config.groupCommitDelayMs);
+            } else if (key == "hot_window_days") {
+                config.hotWindowDays = strToT<std::size_t>(value).value_or(config.hotWindowDays);
+            } else if (key == "hot_window_max_bytes") {
+                config.hotWindowMaxBytes = strToT<std::size_t>(value).value_or(config.hotWindowMaxBytes);
+            } else if (key == "wallet_cache_size") {
+                config.walletCacheSize = strToT<std::size_t>(value).value_or(config.walletCacheSize);
+            }
+        }
+
+        return config;
+    }
+};
+
+class Storage;
+
+// Read-only connection borrowed from Storage's pool. All reads through it see one consistent WAL snapshot, which is
+// released together with the connection.
+class ReadSnapshot {
+public:
+    ReadSnapshot(ReadSnapshot&& other) noexcept:
+        _storage(other._storage), _db(other._db), _transaction(std::move(other._transaction)) {
+        other._db = nullptr;
+    }
+    ReadSnapshot(const ReadSnapshot&) = delete;
+    ReadSnapshot& operator=(const ReadSnapshot&) = delete;
+    ReadSnapshot& operator=(ReadSnapshot&&) = delete;
+
+    inline ~ReadSnapshot();
+
+    Connection& operator*() const noexcept {
+        return *_db;
+    }
+
+    Connection* operator->() const noexcept {
+        return _db;
+    }
+
+private:
+    friend class Storage;
+
+    ReadSnapshot(Storage& storage, Connection& db): _storage(&storage), _db(&db) {
+        _transaction = std::make_unique<SQLite::Transaction>(db);
+    }
+
+    Storage* _storage;
+    Connection* _db;
+    std::unique_ptr<SQLite::Transaction> _transaction;
+};
+
+// Database in WAL mode with one writer connection and a pool of read-only connections, so long reports never block
+// inserts. The writer is not synchronized here, its users serialize access to it themselves.
+class Storage {
+public:
+    Storage(const std::filesystem::path& path, const StorageConfig& config):
+        _path(path), _config(config),
+        _writer(path, SQLite::OPEN_READWRITE | SQLite::OPEN_CREATE | SQLite::OPEN_NOMUTEX, config.busyTimeoutMs) {
+        _writer.exec("PRAGMA journal_mode=WAL");
+        _writer.exec(fmt::format("PRAGMA synchronous={}", config.synchronous));
+        applyCachePragmas(_writer);
+    }
+
+    Storage(const Storage&) = delete;
+    Storage& operator=(const Storage&) = delete;
+
+    const StorageConfig& config() const noexcept {
+        return _config;
+    }
+
+    Connection& writer() noexcept {
+        return _writer;
+    }
+
+    // Readers are opened on first use, after migrations have been applied through the writer.
+    ReadSnapshot read() {
+        std::unique_lock lk(_readersMutex);
+        if (_freeReaders.empty() && _readers.size() < _config.readersCount) {
+            _readers.push_back(std::make_unique<Connection>(_path, SQLite::OPEN_READONLY | SQLite::OPEN_NOMUTEX,
+                _config.busyTimeoutMs));
+            applyCachePragmas(*_readers.back());
+            _freeReaders.push_back(_readers.back().get());
+        }
+        _hasFreeReader.wait(lk, [&]() { return !_freeReaders.empty(); });
+
+        auto* reader = _freeReaders.back();
+        _freeReaders.pop_back();
+        lk.unlock();
+
+        try {
+            return ReadSnapshot(*this, *reader);
+        } catch (...) {
+            release(*reader);
+            throw;
+        }
+    }
+
+private:
+    friend class ReadSnapshot;
+
+    void applyCachePragmas(Connection& db) {
+        db.exec(fmt::format("PRAGMA mmap_size={}", _config.mmapSize));
+        db.exec(fmt::format("PRAGMA cache_size={}", _config.cacheSize));
+    }
+
+    void release(Connection& reader) {
+        {
+            std::unique_lock lk(_readersMutex);
+            _freeReaders.push_back(&reader);
+        }
+        _hasFreeReader.notify_one();
+    }
+
+    std::filesystem::path _path;
+    StorageConfig _config;
+    Connection _writer;
+
+    std::mutex _readersMutex;
+    std::condition_variable _hasFreeReader;
+    std::vector<std::unique_ptr<Connection>> _readers;
+    std::vector<Connection*> _freeReaders;
+};
+
+inline ReadSnapshot::~ReadSnapshot() {
+    if (!_db) {
+        return;
+    }
+    // Rolling back a read-only transaction just ends the snapshot.
+    _transaction.reset();
+    _storage->release(*_db);
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include "../utils.hpp"
+#include "connection.hpp"
+
+#include <SQLiteCpp/SQLiteCpp.h>
+
+#include <absl/container/flat_hash_map.h>
+#include <absl/time/time.h>
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+// Rollup of expenses per chat, local day and tag, so tag reports read at most days × tags rows instead of joining the
+// whole range of Entries with EntryTags. Every EntryTags row counts its entry once, as the join did; entries without
+// tags are summed under UNTAGGED. Kept up to date by WalletEntry::save and EntryTag::save in their transactions.
+struct TagDayTotals {
+    static constexpr std::int64_t UNTAGGED = 0;
+
+    static void add(Connection& db, std::int64_t chatId, absl::CivilDay day, std::int64_t tagId, double amount) {
+        auto query = db.prepare("INSERT INTO TagDayTotals VALUES(?, ?, ?, ?) "
+                                "ON CONFLICT(chat_id, date, tag_id) DO UPDATE SET amount = amount + excluded.amount");
+        query->bind(1, chatId);
+        query->bind(2, dateToInt(day));
+        query->bind(3, tagId);
+        query->bind(4, amount);
+        query->exec();
+    }
+
+    template<class Fn>
+    static void loadForEach(Connection& db, std::int64_t chatId, absl::CivilDay firstDay, absl::CivilDay lastDay,
+        Fn&& fn) {
+        auto query =
+            db.prepare("SELECT tag_id, amount FROM TagDayTotals WHERE chat_id = ? AND date >= ? AND date <= ?");
+        query->bind(1, chatId);
+        query->bind(2, dateToInt(firstDay));
+        query->bind(3, dateToInt(lastDay));
+        while (query->executeStep()) {
+            fn(query->getColumn(0).getInt64(), query->getColumn(1).getDouble());
+        }
+    }
+
+    // Sums entries of chats listed in TagDayTotalsBackfill by the migration that created the rollup, one transaction
+    // per chat. Must run before any entry is saved.
+    static void backfill(Connection& db) {
+        std::vector<std::pair<std::int64_t, absl::TimeZone>> chats;
+        {
+            // Chats without a Wallets row get the zone of a default Wallet, as the server creates them.
+            auto query = db.prepare("SELECT TagDayTotalsBackfill.chat_id, time_zone FROM TagDayTotalsBackfill "
+                                    "LEFT JOIN Wallets ON Wallets.chat_id = TagDayTotalsBackfill.chat_id",
+                QueryPlan::SCAN);
+            while (query->executeStep()) {
+                chats.emplace_back(query->getColumn(0).getInt64(),
+                    query->isColumnNull(1) ? absl::UTCTimeZone() : getTimeZone(query->getColumn(1).getString()));
+            }
+        }
+
+        for (const auto& [chatId, timeZone] : chats) {
+            SQLite::Transaction tr(db);
+
+            absl::flat_hash_map<std::pair<std::int64_t, std::int64_t>, double> totals;
+            auto entries = db.prepare("SELECT ts, amount, tag_id FROM Entries "
+                                      "LEFT JOIN EntryTags ON Entries.id = EntryTags.entry_id WHERE chat_id = ?");
+            entries->bind(1, chatId);
+            while (entries->executeStep()) {
+                const auto day = absl::ToCivilDay(absl::FromUnixSeconds(entries->getColumn(0).getInt64()), timeZone);
+                const auto tagId = entries->isColumnNull(2) ? UNTAGGED : entries->getColumn(2).getInt64();
+                totals[{dateToInt(day), tagId}] += entries->getColumn(1).getDouble();
+            }
+
+            for (const auto& [key, amount] : totals) {
+                add(db, chatId, intToDate(key.first), key.second, amount);
+            }
+
+            auto done = db.prepare("DELETE FROM TagDayTotalsBackfill WHERE chat_id = ?");
+            done->bind(1, chatId);
+            done->exec();
+
+            tr.commit();
+        }
+    }
+};
@@ -0,0 +1,141 @@
+#pragma once
+
+#include "../clock_map.hpp"
+#include "../query_commands.hpp"
+#include "storage.hpp"
+#include "tag.hpp"
+
+#include <tgbot/tgbot.h>
+
+#include <absl/time/clock.h>
+#include <absl/time/time.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// Tags of one chat with the tag buttons of its keyboard prebuilt, so a keyboard for a new entry only needs the entry id
+// substituted into callback data.
+struct ChatTags {
+    struct Button {
+        std::string text;
+        // Callback data is `ADD_ENTRY_TAG <entry id> <tag id>`, this is ` <tag id>`.
+        std::string callbackSuffix;
+    };
+
+    std::unordered_map<std::uint64_t, std::string> names;
+    std::vector<std::vector<Button>> rows;
+
+    static ChatTags load(Connection& db, std::int64_t chatId) {
+        ChatTags tags;
+
+        std::vector<Button> currentRow;
+        std::size_t i = 0;
+        Tag::loadForEach(db, chatId, [&](Tag tag) {
+            if (i++ == 2) {
+                tags.rows.push_back(std::move(currentRow));
+                currentRow.clear();
+                i = 0;
+            }
+            currentRow.push_back({tag.tag, " " + std::to_string(tag.id)});
+            tags.names[tag.id] = std::move(tag.tag);
+        });
+
+        if (!currentRow.empty()) {
+            tags.rows.push_back(std::move(currentRow));
+        }
+
+        return tags;
+    }
+
+    TgBot::InlineKeyboardMarkup::Ptr createKeyboard(std::int64_t entryId) const {
+        if (rows.empty()) {
+            return nullptr;
+        }
+
+        TgBot::InlineKeyboardMarkup::Ptr keyboard(new TgBot::InlineKeyboardMarkup);
+        keyboard->inlineKeyboard.reserve(rows.size() + 1);
+
+        TgBot::InlineKeyboardButton::Ptr cancelButton(new TgBot::InlineKeyboardButton);
+        cancelButton->text = "⬜ Добавить без тэга";
+        cancelButton->callbackData = DELETE_MESSAGE;
+
+        // The time only makes the refreshed keyboard differ from the old one, Telegram rejects unchanged edits.
+        TgBot::InlineKeyboardButton::Ptr refreshButton(new TgBot::InlineKeyboardButton);
+        refreshButton->text = "🔄 Обновить тэги";
+        refreshButton->callbackData = std::string(REFRESH_TAGS) + " " + std::to_string(entryId) + " " +
+                                      std::to_string(absl::ToUnixSeconds(absl::Now()));
+        keyboard->inlineKeyboard.push_back({cancelButton, refreshButton});
+
+        const auto prefix = std::string(ADD_ENTRY_TAG) + " " + std::to_string(entryId);
+        for (const auto& row : rows) {
+            auto& buttons = keyboard->inlineKeyboard.emplace_back();
+            buttons.reserve(row.size());
+            for (const auto& b : row) {
+                TgBot::InlineKeyboardButton::Ptr button(new TgBot::InlineKeyboardButton);
+                button->text = b.text;
+                button->callbackData = prefix + b.callbackSuffix;
+                buttons.push_back(std::move(button));
+            }
+        }
+
+        return keyboard;
+    }
+};
+
+// Per chat ChatTags, loaded from a read snapshot on first use and dropped by invalidate() after a tag is added. Every
+// chat has a version bumped by invalidate(): it is read before the snapshot is taken, and tags loaded under an older
+// version are returned but not kept, so a snapshot from before the new tag can't be cached after the invalidation.
+// At most MAX_CACHED_CHATS chats are kept. Versions come from one counter, so a chat evicted meanwhile doesn't get
+// the version of a load that started before.
+class TagRegistry {
+public:
+    static constexpr std::size_t MAX_CACHED_CHATS = 16384;
+
+    std::shared_ptr<const ChatTags> get(Storage& storage, std::int64_t chatId) {
+        std::uint64_t version;
+        {
+            std::unique_lock lk(_mutex);
+            auto* chat = _chats.find(chatId);
+            if (!chat) {
+                chat = &_chats.insert(chatId, {++_lastVersion, nullptr});
+            } else if (chat->tags) {
+                return chat->tags;
+            }
+            version = chat->version;
+        }
+
+        auto tags = std::make_shared<const ChatTags>(ChatTags::load(*storage.read(), chatId));
+
+        std::unique_lock lk(_mutex);
+        auto* chat = _chats.find(chatId);
+        if (chat && chat->version == version) {
+            chat->tags = tags;
+        }
+        return tags;
+    }
+
+    // Must be called after the change to the chat's tags is committed.
+    void invalidate(std::int64_t chatId) {
+        std::unique_lock lk(_mutex);
+        if (auto* chat = _chats.find(chatId)) {
+            chat->version = ++_lastVersion;
+            chat->tags.reset();
+        }
+    }
+
+private:
+    struct Chat {
+        std::uint64_t version;
+        std::shared_ptr<const ChatTags> tags;
+    };
+
+    std::mutex _mutex;
+    ClockMap<std::int64_t, Chat> _chats{MAX_CACHED_CHATS};
+    std::uint64_t _lastVersion = 0;
+};
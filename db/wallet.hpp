@@ -1,6 +1,7 @@
 #pragma once
 
 #include "../utils.hpp"
+#include "connection.hpp"
 
 #include <SQLiteCpp/SQLiteCpp.h>
 
@@ -9,26 +10,57 @@
 #include <fmt/format.h>
 
 #include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
 
 struct Wallet {
     std::int64_t chatId;
     absl::TimeZone timeZone;
     double dayLimit;
 
-    void save(SQLite::Database& db) const {
-        db.exec(
-            fmt::format("INSERT OR REPLACE INTO Wallets VALUES({}, \"{}\", {}) ", chatId, timeZone.name(), dayLimit));
+    void save(Connection& db) const {
+        auto query = db.prepare("INSERT OR REPLACE INTO Wallets VALUES(?, ?, ?)");
+        query->bind(1, chatId);
+        query->bind(2, timeZone.name());
+        query->bind(3, dayLimit);
+        query->exec();
+    }
+
+    static std::optional<Wallet> load(Connection& db, std::int64_t chatId) {
+        auto query = db.prepare("SELECT * FROM Wallets WHERE chat_id = ?");
+        query->bind(1, chatId);
+        if (!query->executeStep()) {
+            return std::nullopt;
+        }
+        return fromRow(*query);
     }
 
     template<class Fn>
-    static void loadForEach(SQLite::Database& db, Fn&& fn) {
-        SQLite::Statement query(db, fmt::format("SELECT * FROM Wallets"));
-        while (query.executeStep()) {
-            Wallet wallet;
-            wallet.chatId = query.getColumn(0).getInt64();
-            wallet.timeZone = getTimeZone(query.getColumn(1).getString());
-            wallet.dayLimit = query.getColumn(2).getDouble();
-            fn(wallet);
+    static void loadForEachInTimeZone(Connection& db, const std::string& timeZoneName, Fn&& fn) {
+        auto query = db.prepare("SELECT * FROM Wallets WHERE time_zone = ?");
+        query->bind(1, timeZoneName);
+        while (query->executeStep()) {
+            fn(fromRow(*query));
         }
     }
+
+    static std::vector<std::string> loadTimeZoneNames(Connection& db) {
+        std::vector<std::string> names;
+        auto query = db.prepare("SELECT DISTINCT time_zone FROM Wallets", QueryPlan::SCAN);
+        while (query->executeStep()) {
+            names.push_back(query->getColumn(0).getString());
+        }
+
+        return names;
+    }
+
+private:
+    static Wallet fromRow(const SQLite::Statement& query) {
+        Wallet wallet;
+        wallet.chatId = query.getColumn(0).getInt64();
+        wallet.timeZone = getTimeZone(query.getColumn(1).getString());
+        wallet.dayLimit = query.getColumn(2).getDouble();
+        return wallet;
+    }
 };
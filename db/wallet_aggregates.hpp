@@ -0,0 +1,119 @@
+#pragma once
+
+#include "../clock_map.hpp"
+#include "connection.hpp"
+#include "wallet.hpp"
+
+#include <absl/time/clock.h>
+#include <absl/time/time.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+
+struct WalletAggregate {
+    std::optional<absl::Time> firstEntryTime;
+
+    absl::Time dayStart;
+    absl::Time nextDayStart;
+    double daySum;
+
+    std::optional<absl::CivilDay> lastClosedDay;
+    double lastClosedDayBalance;
+};
+
+// In-memory per wallet aggregates, kept in sync by WalletEntry::save and the DayReport backfill. A missing or
+// outdated aggregate is rebuilt from Entries on the next access. At most `capacity` aggregates are kept, the ones of
+// wallets not accessed lately are evicted first.
+class WalletAggregates {
+public:
+    explicit WalletAggregates(std::size_t capacity = 65536): _aggregates(capacity) {}
+
+    const WalletAggregate& get(Connection& db, const Wallet& wallet) {
+        const auto now = absl::Now();
+
+        auto* aggregate = _aggregates.find(wallet.chatId);
+        if (!aggregate) {
+            aggregate = &_aggregates.insert(wallet.chatId, load(db, wallet, now));
+        } else if (now >= aggregate->nextDayStart) {
+            // Nothing was saved after midnight, otherwise onEntrySaved would have dropped the aggregate.
+            setDay(*aggregate, wallet, now);
+            aggregate->daySum = 0;
+        }
+
+        return *aggregate;
+    }
+
+    // Same as get(), but the aggregate of a wallet that isn't cached is built without being kept, so a pass over every
+    // wallet doesn't make the cache hold all of them.
+    WalletAggregate peek(Connection& db, const Wallet& wallet) {
+        if (_aggregates.contains(wallet.chatId)) {
+            return get(db, wallet);
+        }
+        return load(db, wallet, absl::Now());
+    }
+
+    void onEntrySaved(std::int64_t chatId, absl::Time time, double amount) {
+        auto* aggregate = _aggregates.find(chatId);
+        if (!aggregate) {
+            return;
+        }
+
+        if (time >= aggregate->nextDayStart) {
+            _aggregates.erase(chatId);
+            return;
+        }
+
+        if (!aggregate->firstEntryTime || time < *aggregate->firstEntryTime) {
+            aggregate->firstEntryTime = time;
+        }
+        if (time >= aggregate->dayStart) {
+            aggregate->daySum += amount;
+        }
+    }
+
+    void onDayClosed(std::int64_t chatId, absl::CivilDay day, double balance) {
+        auto* aggregate = _aggregates.find(chatId);
+        if (!aggregate) {
+            return;
+        }
+
+        if (!aggregate->lastClosedDay || *aggregate->lastClosedDay < day) {
+            aggregate->lastClosedDay = day;
+            aggregate->lastClosedDayBalance = balance;
+        }
+    }
+
+    void clear() {
+        _aggregates.clear();
+    }
+
+private:
+    static void setDay(WalletAggregate& aggregate, const Wallet& wallet, absl::Time now) {
+        const auto day = absl::ToCivilDay(now, wallet.timeZone);
+        aggregate.dayStart = absl::FromCivil(day, wallet.timeZone);
+        aggregate.nextDayStart = absl::FromCivil(day + 1, wallet.timeZone);
+    }
+
+    static WalletAggregate load(Connection& db, const Wallet& wallet, absl::Time now) {
+        WalletAggregate aggregate{};
+        setDay(aggregate, wallet, now);
+
+        auto firstEntry = db.prepare("SELECT MIN(ts) FROM Entries WHERE chat_id = ?");
+        firstEntry->bind(1, wallet.chatId);
+        if (firstEntry->executeStep() && !firstEntry->isColumnNull(0)) {
+            aggregate.firstEntryTime = absl::FromUnixSeconds(firstEntry->getColumn(0).getInt64());
+        }
+
+        auto daySum = db.prepare("SELECT TOTAL(amount) FROM Entries WHERE chat_id = ? AND ts >= ? AND ts < ?");
+        daySum->bind(1, wallet.chatId);
+        daySum->bind(2, absl::ToUnixSeconds(aggregate.dayStart));
+        daySum->bind(3, absl::ToUnixSeconds(aggregate.nextDayStart));
+        daySum->executeStep();
+        aggregate.daySum = daySum->getColumn(0).getDouble();
+
+        return aggregate;
+    }
+
+    ClockMap<std::int64_t, WalletAggregate> _aggregates;
+};
@@ -0,0 +1,106 @@
+#pragma once
+
+#include "../metrics.hpp"
+#include "wallet.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+using WalletPtr = std::shared_ptr<const Wallet>;
+
+// Wallets of recently active chats, shared between handler threads as handles to immutable Wallets: a change publishes
+// a new Wallet in place of the old one, and a handler holding the old handle keeps a consistent copy. Chats are split
+// between shards with separate locks, each keeping at most its share of `capacity` wallets. When a shard is full, its
+// CLOCK hand evicts the first wallet that wasn't looked up since the hand last passed it.
+class WalletCache {
+public:
+    static constexpr std::size_t SHARDS_COUNT = 16;
+
+    explicit WalletCache(std::size_t capacity):
+        _shardCapacity(std::max<std::size_t>(1, capacity / SHARDS_COUNT)) {}
+
+    WalletPtr find(std::int64_t chatId) {
+        auto& shard = shardOf(chatId);
+        std::unique_lock lk(shard.mutex);
+        auto found = shard.slots.find(chatId);
+        if (found == shard.slots.end()) {
+            _misses.add();
+            return nullptr;
+        }
+
+        _hits.add();
+        auto& slot = shard.ring[found->second];
+        slot.isReferenced = true;
+        return slot.wallet;
+    }
+
+    // Replaces the cached wallet of the same chat, if there is one.
+    void insert(WalletPtr wallet) {
+        const auto chatId = wallet->chatId;
+        auto& shard = shardOf(chatId);
+        std::unique_lock lk(shard.mutex);
+        auto found = shard.slots.find(chatId);
+        if (found != shard.slots.end()) {
+            shard.ring[found->second].wallet = std::move(wallet);
+            return;
+        }
+
+        if (shard.ring.size() < _shardCapacity) {
+            shard.slots.emplace(chatId, shard.ring.size());
+            shard.ring.push_back({std::move(wallet), false});
+            return;
+        }
+
+        while (shard.ring[shard.hand].isReferenced) {
+            shard.ring[shard.hand].isReferenced = false;
+            shard.hand = (shard.hand + 1) % shard.ring.size();
+        }
+        auto& victim = shard.ring[shard.hand];
+        shard.slots.erase(victim.wallet->chatId);
+        _evictions.add();
+
+        victim = {std::move(wallet), false};
+        shard.slots.emplace(chatId, shard.hand);
+        shard.hand = (shard.hand + 1) % shard.ring.size();
+    }
+
+    void clear() {
+        for (auto& shard : _shards) {
+            std::unique_lock lk(shard.mutex);
+            shard.ring.clear();
+            shard.slots.clear();
+            shard.hand = 0;
+        }
+    }
+
+private:
+    struct Slot {
+        WalletPtr wallet;
+        bool isReferenced;
+    };
+
+    struct alignas(64) Shard {
+        std::mutex mutex;
+        std::vector<Slot> ring;
+        // Index of the chat's slot in `ring`.
+        std::unordered_map<std::int64_t, std::size_t> slots;
+        std::size_t hand = 0;
+    };
+
+    Shard& shardOf(std::int64_t chatId) {
+        return _shards[static_cast<std::uint64_t>(chatId) % SHARDS_COUNT];
+    }
+
+    std::size_t _shardCapacity;
+    std::array<Shard, SHARDS_COUNT> _shards;
+
+    Counter& _hits = Metrics::get().counter("wallet_cache_hits_total");
+    Counter& _misses = Metrics::get().counter("wallet_cache_misses_total");
+    Counter& _evictions = Metrics::get().counter("wallet_cache_evictions_total");
+};
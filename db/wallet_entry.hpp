@@ -1,6 +1,9 @@
 #pragma once
 
+#include "connection.hpp"
+#include "tag_day_totals.hpp"
 #include "wallet.hpp"
+#include "wallet_aggregates.hpp"
 
 #include <SQLiteCpp/SQLiteCpp.h>
 
@@ -10,7 +13,28 @@
 
 #include <fmt/format.h>
 
+#include <algorithm>
 #include <cstdint>
+#include <optional>
+#include <vector>
+
+// Ids of new entries: Entries has no rowid to allocate them from. The sequence starts after the largest stored id on
+// first use and is never rewound, so ids of entries in a rolled back batch, which may already be in tag keyboards, are
+// not given to other entries. Not synchronized, used under the storage writer's lock like WalletAggregates.
+class EntryIds {
+public:
+    std::int64_t next(Connection& db) {
+        if (!_lastId) {
+            auto query = db.prepare("SELECT IFNULL(MAX(id), 0) FROM Entries");
+            query->executeStep();
+            _lastId = query->getColumn(0).getInt64();
+        }
+        return ++*_lastId;
+    }
+
+private:
+    std::optional<std::int64_t> _lastId;
+};
 
 struct WalletEntry {
     std::int64_t id;
@@ -20,25 +44,36 @@ struct WalletEntry {
     std::string description;
     std::int64_t messageId;
 
-    void save(SQLite::Database& db) {
-        SQLite::Statement query(db, fmt::format("INSERT INTO Entries VALUES(NULL,{},{},{},\"{}\", {}) RETURNING *;",
-                                        chatId, absl::ToUnixSeconds(time), amount, description, messageId));
-        query.executeStep();
-        id = query.getColumn(0).getInt64();
+    // `timeZone` is the wallet's, it defines the day the entry is rolled up into.
+    void save(Connection& db, EntryIds& ids, WalletAggregates& aggregates, const absl::TimeZone& timeZone) {
+        id = ids.next(db);
+        auto query = db.prepare("INSERT INTO Entries VALUES(?, ?, ?, ?, ?, ?)");
+        query->bind(1, id);
+        query->bind(2, chatId);
+        query->bind(3, absl::ToUnixSeconds(time));
+        query->bind(4, amount);
+        query->bind(5, description);
+        query->bind(6, messageId);
+        query->exec();
+
+        TagDayTotals::add(db, chatId, absl::ToCivilDay(time, timeZone), TagDayTotals::UNTAGGED, amount);
+        aggregates.onEntrySaved(chatId, time, amount);
     }
 
     template<class Fn>
-    static void loadForEach(SQLite::Database& db, std::int64_t chatId, absl::Time first, absl::Time last, Fn&& fn) {
-        SQLite::Statement query(db, fmt::format("SELECT * FROM Entries WHERE chat_id = {} AND ts >= {} AND ts <= {}",
-                                        chatId, absl::ToUnixSeconds(first), absl::ToUnixSeconds(last)));
-        while (query.executeStep()) {
+    static void loadForEach(Connection& db, std::int64_t chatId, absl::Time first, absl::Time last, Fn&& fn) {
+        auto query = db.prepare("SELECT * FROM Entries WHERE chat_id = ? AND ts >= ? AND ts <= ?");
+        query->bind(1, chatId);
+        query->bind(2, absl::ToUnixSeconds(first));
+        query->bind(3, absl::ToUnixSeconds(last));
+        while (query->executeStep()) {
             WalletEntry entry;
-            entry.id = query.getColumn(0).getInt64();
-            entry.chatId = query.getColumn(1).getInt64();
-            entry.time = absl::FromUnixSeconds(query.getColumn(2).getInt64());
-            entry.amount = query.getColumn(3).getDouble();
-            entry.description = query.getColumn(4).getString();
-            entry.messageId = query.getColumn(5).getInt64();
+            entry.id = query->getColumn(0).getInt64();
+            entry.chatId = query->getColumn(1).getInt64();
+            entry.time = absl::FromUnixSeconds(query->getColumn(2).getInt64());
+            entry.amount = query->getColumn(3).getDouble();
+            entry.description = query->getColumn(4).getString();
+            entry.messageId = query->getColumn(5).getInt64();
 
             fn(entry);
         }
@@ -49,35 +84,65 @@ struct WalletEntry {
         std::string day;
     };
 
-    static DaySumInfo getDayAmountSum(SQLite::Database& db, const Wallet& wallet) {
+    static DaySumInfo getDayAmountSum(Connection& db, const Wallet& wallet) {
         return getDaysAmountSum(db, wallet, 1)[0];
     }
 
-    static DaySumInfo getDayAmountSum(SQLite::Database& db, const Wallet& wallet, absl::CivilDay day) {
+    static DaySumInfo getDayAmountSum(Connection& db, const Wallet& wallet, absl::CivilDay day) {
         return getDaysAmountSum(db, wallet, day, 1)[0];
     }
 
-    static absl::InlinedVector<DaySumInfo, 10> getDaysAmountSum(SQLite::Database& db, const Wallet& wallet,
+    static absl::InlinedVector<DaySumInfo, 10> getDaysAmountSum(Connection& db, const Wallet& wallet,
         absl::CivilDay day, std::size_t daysCount) {
-        absl::InlinedVector<DaySumInfo, 10> result;
+        if (daysCount == 0) {
+            return {};
+        }
+        return toDaySums(wallet, day, getAmountsByDays(db, wallet, day - (daysCount - 1), daysCount));
+    }
 
+    // Day sums ending with `lastDay`, newest first, from amounts as returned by getAmountsByDays.
+    static absl::InlinedVector<DaySumInfo, 10> toDaySums(const Wallet& wallet, absl::CivilDay lastDay,
+        const std::vector<double>& amounts) {
+        absl::InlinedVector<DaySumInfo, 10> result;
         const auto& tz = wallet.timeZone;
+        const auto daysCount = amounts.size();
 
         for (std::size_t i = 0; i != daysCount; ++i) {
-            auto dayStart = absl::FromCivil(day - i, tz);
-            auto dayEnd = absl::FromCivil(day - i + 1, tz);
+            const auto dayStart = absl::FromCivil(lastDay - i, tz);
+            result.push_back({amounts[daysCount - 1 - i], absl::FormatTime("%d/%m/%Y", dayStart, tz)});
+        }
 
-            double sum = 0;
-            WalletEntry::loadForEach(db, wallet.chatId, dayStart, dayEnd,
-                [&](const WalletEntry& entry) { sum += entry.amount; });
+        return result;
+    }
 
-            result.push_back({sum, absl::FormatTime("%d/%m/%Y", dayStart, tz)});
+    // Sums of amounts for `daysCount` days starting from `firstDay`, index 0 is `firstDay`. Days are bucketed by the
+    // wallet time zone boundaries, all of them are collected with a single range scan.
+    static std::vector<double> getAmountsByDays(Connection& db, const Wallet& wallet, absl::CivilDay firstDay,
+        std::size_t daysCount) {
+        std::vector<double> amounts(daysCount, 0);
+        if (daysCount == 0) {
+            return amounts;
         }
 
-        return result;
+        std::vector<std::int64_t> dayStarts(daysCount + 1);
+        for (std::size_t i = 0; i != dayStarts.size(); ++i) {
+            dayStarts[i] = absl::ToUnixSeconds(absl::FromCivil(firstDay + i, wallet.timeZone));
+        }
+
+        auto query = db.prepare("SELECT ts, amount FROM Entries WHERE chat_id = ? AND ts >= ? AND ts < ?");
+        query->bind(1, wallet.chatId);
+        query->bind(2, dayStarts.front());
+        query->bind(3, dayStarts.back());
+        while (query->executeStep()) {
+            const auto ts = query->getColumn(0).getInt64();
+            const auto nextDayStart = std::upper_bound(dayStarts.begin(), dayStarts.end(), ts);
+            amounts[nextDayStart - dayStarts.begin() - 1] += query->getColumn(1).getDouble();
+        }
+
+        return amounts;
     }
 
-    static absl::InlinedVector<DaySumInfo, 10> getDaysAmountSum(SQLite::Database& db, const Wallet& wallet,
+    static absl::InlinedVector<DaySumInfo, 10> getDaysAmountSum(Connection& db, const Wallet& wallet,
         std::size_t daysCount) {
 
         const auto nowDay = absl::ToCivilDay(absl::Now(), wallet.timeZone);
@@ -91,25 +156,19 @@ struct WalletEntry {
         double withoutTags;
     };
 
-    static TagsReport getReportByTags(SQLite::Database& db, const Wallet& wallet, std::size_t daysCount) {
-        const auto toTs = absl::Now();
-        const auto fromTs = absl::FromCivil(absl::ToCivilDay(toTs, wallet.timeZone) - daysCount, wallet.timeZone);
+    static TagsReport getReportByTags(Connection& db, const Wallet& wallet, std::size_t daysCount) {
+        const auto today = absl::ToCivilDay(absl::Now(), wallet.timeZone);
 
         TagsReport report{};
 
-        SQLite::Statement query(db,
-            fmt::format("SELECT amount, tag_id FROM Entries LEFT JOIN "
-                        "EntryTags ON Entries.id=EntryTags.entry_id WHERE chat_id = {} AND ts >= {} AND ts <= {} ",
-                wallet.chatId, absl::ToUnixSeconds(fromTs), absl::ToUnixSeconds(toTs)));
-        while (query.executeStep()) {
-            auto amount = query.getColumn(0).getDouble();
+        TagDayTotals::loadForEach(db, wallet.chatId, today - daysCount, today, [&](std::int64_t tagId, double amount) {
             report.total += amount;
-            if (query.isColumnNull(1)) {
+            if (tagId == TagDayTotals::UNTAGGED) {
                 report.withoutTags += amount;
             } else {
-                report.byTags[query.getColumn(1).getInt64()] += amount;
+                report.byTags[tagId] += amount;
             }
-        }
+        });
 
         return report;
     }
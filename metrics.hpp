@@ -0,0 +1,294 @@
+#pragma once
+
+#include <absl/time/clock.h>
+#include <absl/time/time.h>
+
+#include <fmt/format.h>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Threads are spread round-robin over a few stripes on separate cache lines, so concurrent updates rarely contend on
+// one line. There are more threads than stripes and a stripe is shared, every update is an atomic add. Readers sum the
+// stripes.
+constexpr std::size_t METRIC_STRIPES = 8;
+
+inline std::size_t metricStripe() {
+    static std::atomic<std::size_t> nextStripe = 0;
+    thread_local const std::size_t stripe = nextStripe++ % METRIC_STRIPES;
+    return stripe;
+}
+
+class Counter {
+public:
+    void add(std::uint64_t value = 1) {
+        _stripes[metricStripe()].value.fetch_add(value, std::memory_order_relaxed);
+    }
+
+    std::uint64_t value() const {
+        std::uint64_t sum = 0;
+        for (const auto& stripe : _stripes) {
+            sum += stripe.value.load(std::memory_order_relaxed);
+        }
+        return sum;
+    }
+
+private:
+    struct alignas(64) Stripe {
+        std::atomic<std::uint64_t> value = 0;
+    };
+
+    std::array<Stripe, METRIC_STRIPES> _stripes;
+};
+
+// Log-linear histogram of non-negative integer values, as in HdrHistogram: every power of two is split into
+// SUB_BUCKETS buckets, so any recorded value is known within 12.5%.
+class Histogram {
+public:
+    static constexpr std::size_t SUB_BUCKET_BITS = 3;
+    static constexpr std::size_t SUB_BUCKETS = 1 << SUB_BUCKET_BITS;
+    static constexpr std::size_t MAX_MAGNITUDE = 40;
+    static constexpr std::size_t BUCKETS = (MAX_MAGNITUDE - SUB_BUCKET_BITS + 2) * SUB_BUCKETS;
+
+    struct Snapshot {
+        std::array<std::uint64_t, BUCKETS> buckets{};
+        std::uint64_t count = 0;
+        std::uint64_t sum = 0;
+
+        // Upper bound of the bucket holding the quantile `q` of recorded values.
+        std::uint64_t quantile(double q) const {
+            if (count == 0) {
+                return 0;
+            }
+            const auto rank = std::max<std::uint64_t>(1, static_cast<std::uint64_t>(q * count + 0.5));
+            std::uint64_t seen = 0;
+            for (std::size_t i = 0; i != BUCKETS; ++i) {
+                seen += buckets[i];
+                if (seen >= rank) {
+                    return bucketUpperBound(i);
+                }
+            }
+            return bucketUpperBound(BUCKETS - 1);
+        }
+    };
+
+    void record(std::uint64_t value) {
+        auto& stripe = *_stripes[metricStripe()];
+        stripe.buckets[bucketIndex(value)].fetch_add(1, std::memory_order_relaxed);
+        stripe.count.fetch_add(1, std::memory_order_relaxed);
+        stripe.sum.fetch_add(value, std::memory_order_relaxed);
+    }
+
+    void record(absl::Duration duration) {
+        record(static_cast<std::uint64_t>(std::max<std::int64_t>(0, absl::ToInt64Microseconds(duration))));
+    }
+
+    Snapshot snapshot() const {
+        Snapshot snapshot;
+        for (const auto& stripe : _stripes) {
+            for (std::size_t i = 0; i != BUCKETS; ++i) {
+                snapshot.buckets[i] += stripe->buckets[i].load(std::memory_order_relaxed);
+            }
+            snapshot.count += stripe->count.load(std::memory_order_relaxed);
+            snapshot.sum += stripe->sum.load(std::memory_order_relaxed);
+        }
+        return snapshot;
+    }
+
+    static std::size_t bucketIndex(std::uint64_t value) {
+        if (value < SUB_BUCKETS) {
+            return value;
+        }
+        const auto magnitude = std::min<std::size_t>(63 - __builtin_clzll(value), MAX_MAGNITUDE);
+        const auto shift = magnitude - SUB_BUCKET_BITS;
+        const auto subBucket = std::min<std::uint64_t>((value >> shift) - SUB_BUCKETS, SUB_BUCKETS - 1);
+        return (shift + 1) * SUB_BUCKETS + subBucket;
+    }
+
+    static std::uint64_t bucketUpperBound(std::size_t index) {
+        if (index < SUB_BUCKETS) {
+            return index;
+        }
+        const auto shift = index / SUB_BUCKETS - 1;
+        const auto subBucket = index % SUB_BUCKETS;
+        return ((SUB_BUCKETS + subBucket + 1) << shift) - 1;
+    }
+
+private:
+    struct alignas(64) Stripe {
+        std::array<std::atomic<std::uint64_t>, BUCKETS> buckets{};
+        std::atomic<std::uint64_t> count = 0;
+        std::atomic<std::uint64_t> sum = 0;
+    };
+
+    std::array<std::unique_ptr<Stripe>, METRIC_STRIPES> _stripes = [] {
+        std::array<std::unique_ptr<Stripe>, METRIC_STRIPES> stripes;
+        for (auto& stripe : stripes) {
+            stripe = std::make_unique<Stripe>();
+        }
+        return stripes;
+    }();
+};
+
+// Records the time from construction to destruction, in microseconds.
+class ScopedTimer {
+public:
+    explicit ScopedTimer(Histogram& histogram): _histogram(histogram), _start(absl::Now()) {}
+
+    ScopedTimer(const ScopedTimer&) = delete;
+    ScopedTimer& operator=(const ScopedTimer&) = delete;
+
+    ~ScopedTimer() {
+        _histogram.record(absl::Now() - _start);
+    }
+
+private:
+    Histogram& _histogram;
+    absl::Time _start;
+};
+
+// Process-wide registry. Metrics are created on first use and live until exit, so callers keep the returned reference
+// instead of looking it up on every update. `labels` is the Prometheus label list without braces, e.g.
+// `command="report"`.
+class Metrics {
+public:
+    enum class Unit {
+        // Recorded in microseconds, exported in seconds.
+        MICROSECONDS,
+        BYTES,
+    };
+
+    static Metrics& get() {
+        static Metrics metrics;
+        return metrics;
+    }
+
+    Counter& counter(const std::string& name, const std::string& labels = "") {
+        std::unique_lock lk(_mutex);
+        auto& counter = _counters[{name, labels}];
+        if (!counter) {
+            counter = std::make_unique<Counter>();
+        }
+        return *counter;
+    }
+
+    Histogram& histogram(const std::string& name, const std::string& labels = "", Unit unit = Unit::MICROSECONDS) {
+        std::unique_lock lk(_mutex);
+        auto& entry = _histograms[{name, labels}];
+        if (!entry.histogram) {
+            entry.histogram = std::make_unique<Histogram>();
+            entry.unit = unit;
+        }
+        return *entry.histogram;
+    }
+
+    // Prometheus text exposition format. Histograms are exported with a bucket per power of two up to 2^32.
+    std::string prometheusText() const {
+        std::unique_lock lk(_mutex);
+        std::string text;
+
+        std::string lastName;
+        for (const auto& [key, counter] : _counters) {
+            const auto& [name, labels] = key;
+            if (name != lastName) {
+                text += fmt::format("# TYPE {} counter\n", name);
+                lastName = name;
+            }
+            text += fmt::format("{}{} {}\n", name, withLabels(labels), counter->value());
+        }
+
+        lastName.clear();
+        for (const auto& [key, entry] : _histograms) {
+            const auto& [name, labels] = key;
+            if (name != lastName) {
+                text += fmt::format("# TYPE {} histogram\n", name);
+                lastName = name;
+            }
+
+            const auto snapshot = entry.histogram->snapshot();
+            const double scale = entry.unit == Unit::MICROSECONDS ? 1e-6 : 1;
+            const auto separator = labels.empty() ? "" : ",";
+
+            std::uint64_t cumulative = 0;
+            for (std::size_t i = 0; i != Histogram::BUCKETS; ++i) {
+                cumulative += snapshot.buckets[i];
+                if ((i + 1) % Histogram::SUB_BUCKETS == 0 && i < MAX_EXPORTED_BUCKET) {
+                    text += fmt::format("{}_bucket{{{}{}le=\"{}\"}} {}\n", name, labels, separator,
+                        (Histogram::bucketUpperBound(i) + 1) * scale, cumulative);
+                }
+            }
+            text += fmt::format("{}_bucket{{{}{}le=\"+Inf\"}} {}\n", name, labels, separator, snapshot.count);
+            text += fmt::format("{}_sum{} {}\n", name, withLabels(labels), snapshot.sum * scale);
+            text += fmt::format("{}_count{} {}\n", name, withLabels(labels), snapshot.count);
+        }
+
+        return text;
+    }
+
+    // Short report for the bot's admin command: histograms with the most total recorded time first.
+    std::string summary(std::size_t maxLines) const {
+        struct Line {
+            std::string text;
+            std::uint64_t sum;
+        };
+        std::vector<Line> lines;
+        {
+            std::unique_lock lk(_mutex);
+            for (const auto& [key, entry] : _histograms) {
+                const auto snapshot = entry.histogram->snapshot();
+                if (snapshot.count == 0) {
+                    continue;
+                }
+
+                const auto& [name, labels] = key;
+                if (entry.unit == Unit::MICROSECONDS) {
+                    lines.push_back({fmt::format("{} {}: {} шт., p50 {:.1f} мс, p99 {:.1f} мс", name, labels,
+                                         snapshot.count, snapshot.quantile(0.5) / 1000.,
+                                         snapshot.quantile(0.99) / 1000.),
+                        snapshot.sum});
+                } else {
+                    lines.push_back({fmt::format("{} {}: {} шт., p50 {}, p99 {}", name, labels, snapshot.count,
+                                         snapshot.quantile(0.5), snapshot.quantile(0.99)),
+                        0});
+                }
+            }
+        }
+
+        std::stable_sort(lines.begin(), lines.end(), [](const Line& a, const Line& b) { return a.sum > b.sum; });
+        lines.resize(std::min(lines.size(), maxLines));
+
+        std::string text;
+        for (const auto& line : lines) {
+            text += line.text;
+            text += '\n';
+        }
+        return text;
+    }
+
+private:
+    struct HistogramEntry {
+        std::unique_ptr<Histogram> histogram;
+        Unit unit;
+    };
+
+    static constexpr std::size_t MAX_EXPORTED_BUCKET = Histogram::SUB_BUCKETS * 30;
+
+    Metrics() = default;
+
+    static std::string withLabels(const std::string& labels) {
+        return labels.empty() ? labels : "{" + labels + "}";
+    }
+
+    mutable std::mutex _mutex;
+    std::map<std::pair<std::string, std::string>, std::unique_ptr<Counter>> _counters;
+    std::map<std::pair<std::string, std::string>, HistogramEntry> _histograms;
+};
@@ -0,0 +1,111 @@
+#pragma once
+
+#include "metrics.hpp"
+
+#include <fmt/format.h>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdint>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+
+// Serves Metrics::get().prometheusText() on http://127.0.0.1:<port>/metrics for a local Prometheus or curl. Scrapes are
+// rare, so connections are handled one at a time and closed after the response.
+class MetricsServer {
+public:
+    explicit MetricsServer(std::uint16_t port) {
+        _listenFd = ::socket(AF_INET, SOCK_STREAM, 0);
+        int reuse = 1;
+        ::setsockopt(_listenFd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        addr.sin_port = htons(port);
+        if (::bind(_listenFd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 || ::listen(_listenFd, 16) != 0) {
+            ::close(_listenFd);
+            throw std::runtime_error(fmt::format("MetricsServer: can't listen on 127.0.0.1:{}", port));
+        }
+
+        _thread = std::thread([this]() { work(); });
+    }
+
+    ~MetricsServer() {
+        ::shutdown(_listenFd, SHUT_RDWR);
+        ::close(_listenFd);
+        _thread.join();
+    }
+
+    MetricsServer(const MetricsServer&) = delete;
+    MetricsServer& operator=(const MetricsServer&) = delete;
+
+private:
+    void work() {
+        while (true) {
+            const auto fd = ::accept(_listenFd, nullptr, nullptr);
+            if (fd < 0) {
+                if (errno == EINTR || errno == ECONNABORTED) {
+                    continue;
+                }
+                return;
+            }
+
+            try {
+                serve(fd);
+            } catch (const std::exception& e) {
+                std::cerr << "MetricsServer: " << e.what() << '\n';
+            }
+            ::close(fd);
+        }
+    }
+
+    static void serve(int fd) {
+        // A stuck client must not block the next scrape forever.
+        timeval timeout{5, 0};
+        ::setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        ::setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+        std::string request;
+        char chunk[4096];
+        while (request.find("\r\n\r\n") == std::string::npos && request.size() < 64 * 1024) {
+            const auto n = ::recv(fd, chunk, sizeof(chunk), 0);
+            if (n <= 0) {
+                return;
+            }
+            request.append(chunk, n);
+        }
+
+        const auto requestLine = std::string_view(request).substr(0, request.find("\r\n"));
+        std::string response;
+        if (requestLine.substr(0, 13) == "GET /metrics " || requestLine.substr(0, 13) == "GET /metrics?") {
+            const auto body = Metrics::get().prometheusText();
+            response = fmt::format("HTTP/1.1 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\n"
+                                   "Content-Length: {}\r\nConnection: close\r\n\r\n{}",
+                body.size(), body);
+        } else {
+            response = "HTTP/1.1 404 Not Found\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+        }
+
+        std::string_view data = response;
+        while (!data.empty()) {
+            const auto n = ::send(fd, data.data(), data.size(), MSG_NOSIGNAL);
+            if (n <= 0) {
+                return;
+            }
+            data.remove_prefix(n);
+        }
+    }
+
+private:
+    int _listenFd;
+    std::thread _thread;
+};
@@ -30,9 +30,13 @@ public:
             return std::stoi(a.filename().replace_extension("")) < std::stoi(b.filename().replace_extension(""));
         });
 
-        SQLite::Statement query(db, "SELECT version FROM Migration");
-        query.executeStep();
-        auto currentVersion = query.getColumn(0).getInt();
+        int currentVersion;
+        {
+            // Finalized before migrating, SQLite refuses to drop tables or indexes while a statement is still reading.
+            SQLite::Statement query(db, "SELECT version FROM Migration");
+            query.executeStep();
+            currentVersion = query.getColumn(0).getInt();
+        }
 
         SQLite::Transaction tr(db);
         for (auto const& entry : paths) {
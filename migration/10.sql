@@ -0,0 +1,59 @@
+-- Entries of a chat are stored together in time order. Rows without chat_id or ts fail the migration, which is rolled
+-- back as a whole, instead of being dropped silently.
+CREATE TABLE EntriesClustered (
+    id INTEGER NOT NULL,
+    chat_id INTEGER NOT NULL,
+    ts INTEGER NOT NULL,
+    amount REAL,
+    descr TEXT,
+    message_id INTEGER,
+    PRIMARY KEY (chat_id, ts, id)
+) WITHOUT ROWID;
+
+INSERT INTO
+    EntriesClustered
+SELECT
+    id,
+    chat_id,
+    ts,
+    amount,
+    descr,
+    message_id
+FROM
+    Entries;
+
+DROP TABLE Entries;
+
+ALTER TABLE EntriesClustered RENAME TO Entries;
+
+CREATE UNIQUE INDEX EntriesIdIndex ON Entries(id);
+
+CREATE TABLE EntryTagsClustered (
+    entry_id INTEGER NOT NULL,
+    tag_id INTEGER NOT NULL,
+    PRIMARY KEY (entry_id, tag_id)
+) WITHOUT ROWID;
+
+-- DISTINCT rather than OR IGNORE, which would skip NULL rows too.
+INSERT INTO
+    EntryTagsClustered
+SELECT
+    DISTINCT entry_id,
+    tag_id
+FROM
+    EntryTags;
+
+DROP TABLE EntryTags;
+
+ALTER TABLE EntryTagsClustered RENAME TO EntryTags;
+
+-- Duplicate tags are gone, so the rollup is recomputed.
+DELETE FROM
+    TagDayTotals;
+
+INSERT
+    OR IGNORE INTO TagDayTotalsBackfill
+SELECT
+    DISTINCT chat_id
+FROM
+    Entries;
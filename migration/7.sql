@@ -0,0 +1,24 @@
+DROP INDEX IF EXISTS WalletEntriesChatIdIndex;
+
+DROP INDEX IF EXISTS WalletEntriesTsIndex;
+
+CREATE INDEX EntriesChatIdTsIndex ON Entries(chat_id, ts, amount);
+
+CREATE INDEX EntryTagsEntryIdIndex ON EntryTags(entry_id, tag_id);
+
+CREATE INDEX TagsChatIdIndex ON Tags(chat_id);
+
+DELETE FROM
+    DayReports
+WHERE
+    rowid NOT IN (
+        SELECT
+            MIN(rowid)
+        FROM
+            DayReports
+        GROUP BY
+            chat_id,
+            date
+    );
+
+CREATE UNIQUE INDEX DayReportsChatIdDateIndex ON DayReports(chat_id, date);
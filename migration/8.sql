@@ -0,0 +1 @@
+CREATE INDEX WalletsTimeZoneIndex ON Wallets(time_zone);
@@ -0,0 +1,19 @@
+CREATE TABLE TagDayTotals (
+    chat_id INTEGER NOT NULL,
+    -- format YYYYMMDD, in the wallet time zone
+    date INTEGER NOT NULL,
+    -- 0 for expenses without a tag
+    tag_id INTEGER NOT NULL,
+    amount REAL NOT NULL,
+    PRIMARY KEY (chat_id, date, tag_id)
+) WITHOUT ROWID;
+
+-- Days depend on wallet time zones, so existing entries are summed by TagDayTotals::backfill on the next start.
+CREATE TABLE TagDayTotalsBackfill (chat_id INTEGER PRIMARY KEY);
+
+INSERT INTO
+    TagDayTotalsBackfill
+SELECT
+    DISTINCT chat_id
+FROM
+    Entries;
@@ -0,0 +1,168 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <iterator>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// Runs outgoing Bot API calls on a fixed set of threads, so handlers don't wait for Telegram. Calls posted for one chat
+// run one at a time in posting order and replies never overtake each other. Calls of different chats and unordered
+// calls run in parallel, each of them waiting on its own request to the HTTP client. A reply that takes time to prepare
+// reserves its place in the chat's order up front, and calls posted after it wait until it is filled and run.
+class OutboundQueue {
+public:
+    using Call = std::function<void()>;
+
+    struct Slot {
+        std::int64_t chatId;
+        std::uint64_t id;
+    };
+
+    explicit OutboundQueue(std::size_t threadsCount) {
+        for (std::size_t i = 0; i != threadsCount; ++i) {
+            _threads.emplace_back([this]() { work(); });
+        }
+    }
+
+    ~OutboundQueue() {
+        {
+            std::unique_lock lk(_mutex);
+            _isRunning = false;
+        }
+        _hasCalls.notify_all();
+        for (auto& thread : _threads) {
+            thread.join();
+        }
+    }
+
+    void post(std::int64_t chatId, Call call) {
+        std::unique_lock lk(_mutex);
+        auto& chat = _chats[chatId];
+        chat.calls.push_back({_nextSlotId++, std::move(call)});
+        schedule(chatId, chat);
+    }
+
+    // Every reserved slot must be filled, the chat's later calls don't run before it.
+    Slot reserve(std::int64_t chatId) {
+        std::unique_lock lk(_mutex);
+        const auto id = _nextSlotId++;
+        _chats[chatId].calls.push_back({id, nullptr});
+        return {chatId, id};
+    }
+
+    // Reserves the place right after the chat's running call. Must be called from that call, so a reply it gives up
+    // on can be replaced without letting the chat's later calls overtake the replacement.
+    Slot reserveNext(std::int64_t chatId) {
+        std::unique_lock lk(_mutex);
+        const auto id = _nextSlotId++;
+        auto& calls = _chats.at(chatId).calls;
+        calls.insert(std::next(calls.begin()), {id, nullptr});
+        return {chatId, id};
+    }
+
+    void fill(const Slot& slot, Call call) {
+        std::unique_lock lk(_mutex);
+        auto& chat = _chats.at(slot.chatId);
+        for (auto& pending : chat.calls) {
+            if (pending.id == slot.id) {
+                pending.call = std::move(call);
+                break;
+            }
+        }
+        schedule(slot.chatId, chat);
+    }
+
+    // For calls that don't have to be ordered with the chat's replies, like reactions.
+    void postUnordered(Call call) {
+        std::unique_lock lk(_mutex);
+        _ready.push_back(std::move(call));
+        _hasCalls.notify_one();
+    }
+
+private:
+    struct PendingCall {
+        std::uint64_t id;
+        // Empty while the slot is reserved.
+        Call call;
+    };
+
+    struct ChatCalls {
+        std::deque<PendingCall> calls;
+        bool isScheduled = false;
+    };
+
+    // Otherwise the chat is already queued or running, or waits for its first slot to be filled; its next call is
+    // picked up after that.
+    void schedule(std::int64_t chatId, ChatCalls& chat) {
+        if (chat.isScheduled || chat.calls.empty() || !chat.calls.front().call) {
+            return;
+        }
+        chat.isScheduled = true;
+        _ready.push_back([this, chatId]() { runNext(chatId); });
+        _hasCalls.notify_one();
+    }
+
+    void runNext(std::int64_t chatId) {
+        Call call;
+        {
+            std::unique_lock lk(_mutex);
+            call = std::move(_chats.at(chatId).calls.front().call);
+        }
+
+        try {
+            call();
+        } catch (const std::exception& e) {
+            std::cerr << "OutboundQueue: " << e.what() << '\n';
+        }
+
+        std::unique_lock lk(_mutex);
+        auto found = _chats.find(chatId);
+        auto& chat = found->second;
+        chat.calls.pop_front();
+        chat.isScheduled = false;
+        if (chat.calls.empty()) {
+            _chats.erase(found);
+        } else {
+            // Back of the queue, so a chat with many replies doesn't hold up the others.
+            schedule(chatId, chat);
+        }
+    }
+
+    void work() {
+        std::unique_lock lk(_mutex);
+        while (true) {
+            _hasCalls.wait(lk, [&]() { return !_ready.empty() || !_isRunning; });
+            if (!_isRunning) {
+                return;
+            }
+
+            auto call = std::move(_ready.front());
+            _ready.pop_front();
+            lk.unlock();
+
+            try {
+                call();
+            } catch (const std::exception& e) {
+                std::cerr << "OutboundQueue: " << e.what() << '\n';
+            }
+
+            lk.lock();
+        }
+    }
+
+private:
+    std::mutex _mutex;
+    std::condition_variable _hasCalls;
+    std::deque<Call> _ready;
+    std::unordered_map<std::int64_t, ChatCalls> _chats;
+    std::uint64_t _nextSlotId = 0;
+    bool _isRunning = true;
+    std::vector<std::thread> _threads;
+};
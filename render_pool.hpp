@@ -0,0 +1,150 @@
+#pragma once
+
+#include "metrics.hpp"
+#include "table.hpp"
+
+#include <absl/time/clock.h>
+#include <absl/time/time.h>
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <iostream>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Renders tables on a fixed set of worker threads. Every worker measures and draws through its own thread_local
+// TextMeasurer, so Pango objects are never shared between threads. The queue is bounded: submit() blocks the caller
+// while it is full.
+class RenderPool {
+public:
+    // Gets nullopt if the table couldn't be rendered.
+    using Callback = std::function<void(std::optional<std::string> png)>;
+
+    struct Stats {
+        std::size_t queueDepth;
+        std::size_t maxQueueDepth;
+        std::size_t rendered;
+        std::size_t failed;
+        absl::Duration totalRenderTime;
+        absl::Duration maxRenderTime;
+    };
+
+    RenderPool(std::size_t threadsCount, std::size_t maxQueueSize): _maxQueueSize(maxQueueSize) {
+        for (std::size_t i = 0; i != threadsCount; ++i) {
+            _threads.emplace_back([this]() { work(); });
+        }
+    }
+
+    ~RenderPool() {
+        {
+            std::unique_lock lk(_mutex);
+            _isRunning = false;
+        }
+        _hasTasks.notify_all();
+        _hasSpace.notify_all();
+        for (auto& thread : _threads) {
+            thread.join();
+        }
+
+        // Workers stop without taking the rest of the queue, its callbacks still have to fire once.
+        for (auto& task : _tasks) {
+            call(task.cb, std::nullopt);
+        }
+    }
+
+    // `cb` is called once: on the worker thread with the rendered PNG, or with nullopt if the pool stops first.
+    void submit(Table table, Callback cb) {
+        std::unique_lock lk(_mutex);
+        _hasSpace.wait(lk, [&]() { return _tasks.size() < _maxQueueSize || !_isRunning; });
+        if (!_isRunning) {
+            lk.unlock();
+            cb(std::nullopt);
+            return;
+        }
+
+        _tasks.push_back({std::move(table), std::move(cb)});
+        _stats.maxQueueDepth = std::max(_stats.maxQueueDepth, _tasks.size());
+        _hasTasks.notify_one();
+    }
+
+    Stats stats() const {
+        std::unique_lock lk(_mutex);
+        auto stats = _stats;
+        stats.queueDepth = _tasks.size();
+
+        return stats;
+    }
+
+private:
+    struct Task {
+        Table table;
+        Callback cb;
+    };
+
+    void work() {
+        std::unique_lock lk(_mutex);
+        while (true) {
+            _hasTasks.wait(lk, [&]() { return !_tasks.empty() || !_isRunning; });
+            if (!_isRunning) {
+                return;
+            }
+
+            auto task = std::move(_tasks.front());
+            _tasks.pop_front();
+            _hasSpace.notify_one();
+            lk.unlock();
+
+            const auto start = absl::Now();
+            std::optional<std::string> png;
+            bool isRendered = true;
+            try {
+                png = task.table.render();
+            } catch (const std::exception& e) {
+                isRendered = false;
+                std::cerr << "RenderPool: failed to render a table: " << e.what() << '\n';
+            }
+            const auto renderTime = absl::Now() - start;
+            if (isRendered) {
+                _renderTimeHistogram.record(renderTime);
+                _pngBytesHistogram.record(png->size());
+            }
+
+            call(task.cb, std::move(png));
+
+            lk.lock();
+            if (isRendered) {
+                ++_stats.rendered;
+                _stats.totalRenderTime += renderTime;
+                _stats.maxRenderTime = std::max(_stats.maxRenderTime, renderTime);
+            } else {
+                ++_stats.failed;
+            }
+        }
+    }
+
+    static void call(const Callback& cb, std::optional<std::string> png) {
+        try {
+            cb(std::move(png));
+        } catch (const std::exception& e) {
+            std::cerr << "RenderPool: " << e.what() << '\n';
+        }
+    }
+
+private:
+    mutable std::mutex _mutex;
+    std::condition_variable _hasTasks;
+    std::condition_variable _hasSpace;
+    std::deque<Task> _tasks;
+    std::size_t _maxQueueSize;
+    bool _isRunning = true;
+    Stats _stats{};
+    Histogram& _renderTimeHistogram = Metrics::get().histogram("wallet_render_duration_seconds");
+    Histogram& _pngBytesHistogram = Metrics::get().histogram("wallet_render_png_bytes", "", Metrics::Unit::BYTES);
+    std::vector<std::thread> _threads;
+};
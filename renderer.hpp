@@ -7,43 +7,87 @@
 #include <pangomm/fontmap.h>
 
 #include <string>
+#include <unordered_map>
+#include <utility>
 
 constexpr auto DEFAULT_FONT = "Noto Sans Mono";
 constexpr auto DEFAULT_FONT_SIZE = 24 * PANGO_SCALE;
 constexpr auto DEFAULT_PADDING = 20;
 
-inline std::pair<std::size_t, std::size_t> calcTextSize(const std::string& text) {
-    auto tempSurface = Cairo::ImageSurface::create(Cairo::Format::FORMAT_RGB24, 1, 1);
-    auto tempCr = Cairo::Context::create(tempSurface);
-    auto layout = Pango::Layout::create(tempCr);
-
-    Pango::FontDescription fontDesc(DEFAULT_FONT);
-    fontDesc.set_size(DEFAULT_FONT_SIZE);
-
-    layout->set_wrap(Pango::WRAP_CHAR);
-    layout->set_font_description(fontDesc);
-    layout->set_text(text);
-
-    int textWidth, textHeight;
-    layout->get_pixel_size(textWidth, textHeight);
+// Keeps one Pango layout alive for measuring text and remembers sizes of recently measured strings. Pango objects
+// are not thread-safe, so every thread gets its own instance through TextMeasurer::get().
+class TextMeasurer {
+public:
+    static constexpr std::size_t MAX_CACHED_SIZES = 4096;
+
+    TextMeasurer():
+        _surface(Cairo::ImageSurface::create(Cairo::Format::FORMAT_RGB24, 1, 1)),
+        _context(Cairo::Context::create(_surface)),
+        _layout(Pango::Layout::create(_context)),
+        _fontDesc(DEFAULT_FONT) {
+        _fontDesc.set_size(DEFAULT_FONT_SIZE);
+        _layout->set_wrap(Pango::WRAP_CHAR);
+        _layout->set_font_description(_fontDesc);
+    }
+
+    static TextMeasurer& get() {
+        thread_local TextMeasurer measurer;
+        return measurer;
+    }
+
+    std::pair<std::size_t, std::size_t> textSize(const std::string& text) {
+        auto found = _sizes.find(text);
+        if (found != _sizes.end()) {
+            return found->second;
+        }
+
+        _layout->set_text(text);
+        int textWidth, textHeight;
+        _layout->get_pixel_size(textWidth, textHeight);
+
+        if (_sizes.size() == MAX_CACHED_SIZES) {
+            _sizes.clear();
+        }
+        std::pair<std::size_t, std::size_t> size(textWidth, textHeight);
+        _sizes.emplace(text, size);
+
+        return size;
+    }
+
+    const Pango::FontDescription& fontDescription() const {
+        return _fontDesc;
+    }
+
+private:
+    Cairo::RefPtr<Cairo::ImageSurface> _surface;
+    Cairo::RefPtr<Cairo::Context> _context;
+    Glib::RefPtr<Pango::Layout> _layout;
+    Pango::FontDescription _fontDesc;
+
+    std::unordered_map<std::string, std::pair<std::size_t, std::size_t>> _sizes;
+};
 
-    return {textWidth, textHeight};
+inline std::pair<std::size_t, std::size_t> calcTextSize(const std::string& text) {
+    return TextMeasurer::get().textSize(text);
 }
 
-inline void drawImage(const std::string& text, const std::string& ouputFile) {
-    auto tempSurface = Cairo::ImageSurface::create(Cairo::Format::FORMAT_RGB24, 1, 1);
-    auto tempCr = Cairo::Context::create(tempSurface);
-    auto layout = Pango::Layout::create(tempCr);
+// Encodes the surface as PNG in memory. The stream is collected in a per-thread buffer that keeps its capacity between
+// calls, so only the returned copy is allocated.
+inline std::string writePng(const Cairo::RefPtr<Cairo::ImageSurface>& surface) {
+    thread_local std::string buffer;
+    buffer.clear();
 
-    Pango::FontDescription fontDesc("Noto Sans Mono");
-    fontDesc.set_size(24 * PANGO_SCALE);
+    surface->write_to_png_stream([](const unsigned char* data, unsigned int length) -> Cairo::ErrorStatus {
+        buffer.append(reinterpret_cast<const char*>(data), length);
+        return CAIRO_STATUS_SUCCESS;
+    });
 
-    layout->set_wrap(Pango::WRAP_CHAR);
-    layout->set_font_description(fontDesc);
-    layout->set_text(text);
+    return buffer;
+}
 
-    int textWidth, textHeight;
-    layout->get_pixel_size(textWidth, textHeight);
+inline std::string drawImage(const std::string& text) {
+    auto& measurer = TextMeasurer::get();
+    const auto [textWidth, textHeight] = measurer.textSize(text);
 
     int imageWidth = textWidth + 2 * DEFAULT_PADDING;
     int imageHeight = textHeight + 2 * DEFAULT_PADDING;
@@ -56,15 +100,16 @@ inline void drawImage(const std::string& text, const std::string& ouputFile) {
 
     cr->move_to(DEFAULT_PADDING, DEFAULT_PADDING);
 
-    layout = Pango::Layout::create(cr);
+    auto layout = Pango::Layout::create(cr);
+    layout->set_wrap(Pango::WRAP_CHAR);
     layout->set_text(text);
     Pango::AttrList list;
     Pango::Attribute attr = Pango::Attribute::create_attr_foreground(65535 * (222 / 255.0f), 65535 * (222 / 255.0f),
         65535 * (222 / 255.0f));
     list.insert(attr);
     layout->set_attributes(list);
-    layout->set_font_description(fontDesc);
+    layout->set_font_description(measurer.fontDescription());
     layout->show_in_cairo_context(cr);
 
-    surface->write_to_png(ouputFile);
+    return writePng(surface);
 }
@@ -0,0 +1,123 @@
+#pragma once
+
+#include "clock_map.hpp"
+
+#include <absl/time/civil_time.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <vector>
+
+enum class ReportKind : std::uint8_t {
+    DAYS,
+    TAGS,
+};
+
+// Telegram file_ids of report images that were already uploaded, so a repeated report is resent without rendering.
+// Every chat has a data version, bumped after each committed change to its entries. A cached report is valid only for
+// the version and the local day it was built for, so changes and day rollover both make it unreachable. Versions come
+// from one counter, so a chat evicted and cached again never reuses a version of a report built before.
+class ReportCache {
+public:
+    static constexpr std::size_t MAX_CACHED_CHATS = 1024;
+    static constexpr std::size_t MAX_REPORTS_PER_CHAT = 8;
+
+    struct Key {
+        std::int64_t chatId;
+        ReportKind kind;
+        std::size_t daysCount;
+        absl::CivilDay day;
+        std::uint64_t version;
+    };
+
+    Key key(std::int64_t chatId, ReportKind kind, std::size_t daysCount, absl::CivilDay day) {
+        std::unique_lock lk(_mutex);
+        auto* chat = _chats.find(chatId);
+        if (!chat) {
+            chat = &_chats.insert(chatId, {++_lastVersion, {}});
+        }
+        return {chatId, kind, daysCount, day, chat->version};
+    }
+
+    std::optional<std::string> find(const Key& key) {
+        std::unique_lock lk(_mutex);
+        auto* chat = _chats.find(key.chatId);
+        if (!chat || chat->version != key.version) {
+            return std::nullopt;
+        }
+
+        for (const auto& report : chat->reports) {
+            if (report.kind == key.kind && report.daysCount == key.daysCount && report.day == key.day) {
+                return report.fileId;
+            }
+        }
+        return std::nullopt;
+    }
+
+    // Reports built from an outdated version or for a chat evicted since are dropped.
+    void insert(const Key& key, std::string fileId) {
+        std::unique_lock lk(_mutex);
+        auto* chat = _chats.find(key.chatId);
+        if (!chat || chat->version != key.version) {
+            return;
+        }
+
+        auto& reports = chat->reports;
+        for (auto report = reports.begin(); report != reports.end();) {
+            if (report->day != key.day || (report->kind == key.kind && report->daysCount == key.daysCount)) {
+                report = reports.erase(report);
+            } else {
+                ++report;
+            }
+        }
+        if (reports.size() == MAX_REPORTS_PER_CHAT) {
+            reports.erase(reports.begin());
+        }
+        reports.push_back({key.kind, key.daysCount, key.day, std::move(fileId)});
+    }
+
+    void erase(const Key& key) {
+        std::unique_lock lk(_mutex);
+        auto* chat = _chats.find(key.chatId);
+        if (!chat) {
+            return;
+        }
+
+        auto& reports = chat->reports;
+        for (auto report = reports.begin(); report != reports.end(); ++report) {
+            if (report->kind == key.kind && report->daysCount == key.daysCount && report->day == key.day) {
+                reports.erase(report);
+                return;
+            }
+        }
+    }
+
+    void bumpVersion(std::int64_t chatId) {
+        std::unique_lock lk(_mutex);
+        // A chat that isn't cached gets a new version on the next key().
+        if (auto* chat = _chats.find(chatId)) {
+            chat->version = ++_lastVersion;
+            chat->reports.clear();
+        }
+    }
+
+private:
+    struct Report {
+        ReportKind kind;
+        std::size_t daysCount;
+        absl::CivilDay day;
+        std::string fileId;
+    };
+
+    struct ChatReports {
+        std::uint64_t version;
+        std::vector<Report> reports;
+    };
+
+    std::mutex _mutex;
+    ClockMap<std::int64_t, ChatReports> _chats{MAX_CACHED_CHATS};
+    std::uint64_t _lastVersion = 0;
+};
@@ -2,61 +2,74 @@
 
 #include <condition_variable>
 #include <cstddef>
+#include <deque>
 #include <functional>
-#include <map>
+#include <iostream>
 #include <mutex>
 #include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
 
 #include <absl/time/clock.h>
 #include <absl/time/time.h>
 
+// Timer queue built on a binary min-heap of task ids. Every task remembers its heap position, so schedule, removeTask
+// and reschedule are O(log n). The timer thread only pops due tasks, callbacks run on a pool of worker threads.
 class Scheduler {
 public:
     using Callback = std::function<void(absl::Time time)>;
 
-    Scheduler() {
-        _isRunning = true;
-        _thread = std::thread([&]() {
+    explicit Scheduler(std::size_t workersCount = 1) {
+        for (std::size_t i = 0; i != workersCount; ++i) {
+            _workers.emplace_back([this]() { work(); });
+        }
+
+        _thread = std::thread([this]() {
             std::unique_lock lk(_mutex);
 
             while (_isRunning) {
-                std::vector<CallbackData> needExecute;
-                auto now = absl::Now();
-                for (auto& cb : _callbacks) {
-                    if (cb.first <= now) {
-                        needExecute.push_back(cb.second);
-                    }
-                }
-
-                lk.unlock();
-                for (const auto& cb : needExecute) {
-                    cb.cb(cb.tp);
-                }
-                lk.lock();
-
-                for (const auto& cb : needExecute) {
-                    if (cb.repeatInterval == absl::Duration{}) {
-                        removeTask(cb.id);
+                const auto now = absl::Now();
+                while (!_heap.empty() && _heap.front().tp <= now) {
+                    const auto id = _heap.front().id;
+                    auto& task = _tasks.at(id);
+                    _jobs.push_back([cb = task.cb, tp = _heap.front().tp]() { cb(tp); });
+                    _hasJobs.notify_one();
+
+                    if (task.repeatInterval <= absl::ZeroDuration()) {
+                        removeTask(id, lk);
                     } else {
-                        increaseTaskTpIfExist(cb.id, cb.repeatInterval);
+                        // Missed repeats are skipped instead of being fired back to back.
+                        auto next = _heap.front().tp + task.repeatInterval;
+                        if (next <= now) {
+                            next += absl::Floor(now - next, task.repeatInterval) + task.repeatInterval;
+                        }
+                        _heap.front().tp = next;
+                        siftDown(0);
                     }
                 }
 
-                if (_callbacks.empty()) {
+                if (_heap.empty()) {
                     _cond.wait(lk);
                 } else {
-                    now = absl::Now();
-                    auto delta = _callbacks.begin()->first - now;
-                    _cond.wait_for(lk, absl::ToChronoMicroseconds(delta));
+                    _cond.wait_for(lk, absl::ToChronoMicroseconds(_heap.front().tp - absl::Now()));
                 }
             }
         });
     }
 
     ~Scheduler() {
-        std::unique_lock lk(_mutex);
-        _isRunning = false;
+        {
+            std::unique_lock lk(_mutex);
+            _isRunning = false;
+        }
         _cond.notify_all();
+        _hasJobs.notify_all();
+
+        _thread.join();
+        for (auto& worker : _workers) {
+            worker.join();
+        }
     }
 
     void removeTask(std::size_t id) {
@@ -66,45 +79,140 @@ public:
 
     std::size_t schedule(absl::Time tp, Callback cb, absl::Duration repeatInterval = absl::Duration{}) {
         std::unique_lock lk(_mutex);
-        _callbacks.emplace(tp, CallbackData{_nextId, tp, std::move(cb)});
+        const auto id = _nextId++;
+        _tasks.emplace(id, TaskData{std::move(cb), repeatInterval, _heap.size()});
+        _heap.push_back({tp, id});
+        siftUp(_heap.size() - 1);
+
+        if (_heap.front().id == id) {
+            _cond.notify_one();
+        }
+        return id;
+    }
+
+    // Moves an existing task to `tp`. Returns false if the task is already gone.
+    bool reschedule(std::size_t id, absl::Time tp) {
+        std::unique_lock lk(_mutex);
+        auto found = _tasks.find(id);
+        if (found == _tasks.end()) {
+            return false;
+        }
+
+        const auto idx = found->second.heapIndex;
+        _heap[idx].tp = tp;
+        siftUp(idx);
+        siftDown(_tasks.at(id).heapIndex);
 
-        _cond.notify_one();
-        return _nextId++;
+        // Timer thread only cares if the earliest deadline has changed.
+        if (idx == 0 || _heap.front().id == id) {
+            _cond.notify_one();
+        }
+        return true;
+    }
+
+    std::size_t tasksCount() const {
+        std::unique_lock lk(_mutex);
+        return _tasks.size();
     }
 
 private:
-    void increaseTaskTpIfExist(std::size_t id, absl::Duration repeatInterval) {
-        for (auto it = _callbacks.begin(); it != _callbacks.end(); ++it) {
-            if (it->second.id == id) {
-                auto cb = std::move(it->second);
-                _callbacks.erase(it);
-                _callbacks.emplace(cb.tp + cb.repeatInterval, std::move(cb));
+    struct HeapNode {
+        absl::Time tp;
+        std::size_t id;
+    };
+
+    struct TaskData {
+        Callback cb;
+        absl::Duration repeatInterval;
+        std::size_t heapIndex;
+    };
 
+    void removeTask(std::size_t id, const std::unique_lock<std::mutex>& lk) {
+        auto found = _tasks.find(id);
+        if (found == _tasks.end()) {
+            return;
+        }
+
+        const auto idx = found->second.heapIndex;
+        _tasks.erase(found);
+
+        const auto last = _heap.size() - 1;
+        if (idx != last) {
+            _heap[idx] = _heap[last];
+            _tasks.at(_heap[idx].id).heapIndex = idx;
+        }
+        _heap.pop_back();
+
+        if (idx < _heap.size()) {
+            siftUp(idx);
+            siftDown(_tasks.at(_heap[idx].id).heapIndex);
+        }
+    }
+
+    void swapNodes(std::size_t a, std::size_t b) {
+        std::swap(_heap[a], _heap[b]);
+        _tasks.at(_heap[a].id).heapIndex = a;
+        _tasks.at(_heap[b].id).heapIndex = b;
+    }
+
+    void siftUp(std::size_t idx) {
+        while (idx != 0) {
+            const auto parent = (idx - 1) / 2;
+            if (!(_heap[idx].tp < _heap[parent].tp)) {
                 return;
             }
+            swapNodes(idx, parent);
+            idx = parent;
         }
     }
 
-    void removeTask(std::size_t id, const std::unique_lock<std::mutex>& lk) {
-        for (auto it = _callbacks.begin(); it != _callbacks.end(); ++it) {
-            if (it->second.id == id) {
-                _callbacks.erase(it);
+    void siftDown(std::size_t idx) {
+        while (true) {
+            auto smallest = idx;
+            for (auto child : {2 * idx + 1, 2 * idx + 2}) {
+                if (child < _heap.size() && _heap[child].tp < _heap[smallest].tp) {
+                    smallest = child;
+                }
+            }
+            if (smallest == idx) {
                 return;
             }
+            swapNodes(idx, smallest);
+            idx = smallest;
+        }
+    }
+
+    void work() {
+        std::unique_lock lk(_mutex);
+        while (true) {
+            _hasJobs.wait(lk, [&]() { return !_jobs.empty() || !_isRunning; });
+            if (!_isRunning) {
+                return;
+            }
+
+            auto job = std::move(_jobs.front());
+            _jobs.pop_front();
+            lk.unlock();
+            try {
+                job();
+            } catch (const std::exception& e) {
+                std::cerr << "Scheduler: " << e.what() << '\n';
+            }
+            lk.lock();
         }
     }
 
 private:
-    std::mutex _mutex;
+    mutable std::mutex _mutex;
     std::thread _thread;
     std::condition_variable _cond;
     std::size_t _nextId = 0;
-    bool _isRunning;
-    struct CallbackData {
-        std::size_t id;
-        absl::Time tp;
-        Callback cb;
-        absl::Duration repeatInterval;
-    };
-    std::multimap<absl::Time, CallbackData> _callbacks;
+    bool _isRunning = true;
+
+    std::vector<HeapNode> _heap;
+    std::unordered_map<std::size_t, TaskData> _tasks;
+
+    std::condition_variable _hasJobs;
+    std::deque<std::function<void()>> _jobs;
+    std::vector<std::thread> _workers;
 };
@@ -1,12 +1,29 @@
 #pragma once
 
+#include "curl_multi_http_client.hpp"
+#include "db/connection.hpp"
 #include "db/day_report.hpp"
+#include "db/day_sums.hpp"
 #include "db/entry_tag.hpp"
+#include "db/group_commit.hpp"
+#include "db/hot_window.hpp"
+#include "db/storage.hpp"
 #include "db/tag.hpp"
+#include "db/tag_day_totals.hpp"
+#include "db/tag_registry.hpp"
 #include "db/wallet.hpp"
+#include "db/wallet_aggregates.hpp"
+#include "db/wallet_cache.hpp"
 #include "db/wallet_entry.hpp"
+#include "metrics.hpp"
+#include "metrics_server.hpp"
+#include "outbound_queue.hpp"
+#include "render_pool.hpp"
 #include "renderer.hpp"
+#include "report_cache.hpp"
+#include "scheduler.hpp"
 #include "table.hpp"
+#include "update_dispatcher.hpp"
 
 #include "query_commands.hpp"
 
@@ -25,38 +42,72 @@
 #include <fort.hpp>
 
 #include <tgbot/Bot.h>
-#include <tgbot/net/CurlHttpClient.h>
-#include <tgbot/net/TgLongPoll.h>
 #include <tgbot/types/ReactionTypeEmoji.h>
 
 #include <fmt/format.h>
 
 #include <cstdint>
+#include <functional>
+#include <future>
 #include <iostream>
+#include <mutex>
 #include <string>
 #include <unordered_map>
+#include <unordered_set>
 #include <vector>
 
+constexpr std::size_t RENDER_THREADS = 2;
+constexpr std::size_t RENDER_QUEUE_SIZE = 64;
+constexpr std::size_t UPDATE_THREADS = 16;
+constexpr std::size_t UPDATE_QUEUE_SIZE = 256;
+constexpr std::size_t OUTBOUND_THREADS = 16;
+constexpr std::size_t HTTP_MAX_CONNECTIONS = 8;
+// Nightly DayReports are computed this long after local midnight, so late expenses of the previous day are included.
+constexpr auto NIGHTLY_REPORTS_DELAY = absl::Minutes(5);
+constexpr std::size_t NIGHTLY_REPORTS_BATCH_SIZE = 256;
+constexpr std::size_t METRICS_SUMMARY_LINES = 30;
+
 class Server {
 public:
-    Server(const std::filesystem::path& rootDir):
-        _db(rootDir / "wallet.db", SQLite::OPEN_READWRITE | SQLite::OPEN_CREATE) {
-        Migration(rootDir, _db);
+    Server(const std::filesystem::path& rootDir, const std::string& apiUrl = "https://api.telegram.org"):
+        _storage(rootDir / "wallet.db", StorageConfig::load(rootDir)),
+        _wallets(_storage.config().walletCacheSize),
+        _aggregates(_storage.config().walletCacheSize),
+        _hotWindow(_storage.config().hotWindowDays, _storage.config().hotWindowMaxBytes),
+        _daySums(_storage.config().walletCacheSize),
+        _groupCommit(_storage.writer(), _storageMutex, _storage.config().groupCommitSize,
+            absl::Milliseconds(_storage.config().groupCommitDelayMs),
+            [this]() {
+                _wallets.clear();
+                _aggregates.clear();
+                _daySums.clear();
+            }),
+        _renderPool(RENDER_THREADS, RENDER_QUEUE_SIZE) {
+        Migration(rootDir, _storage.writer());
+        TagDayTotals::backfill(_storage.writer());
 
         auto token = findToken(rootDir);
         if (!token) {
             exit(0);
         }
+        if (auto port = findMetricsPort(rootDir)) {
+            _metricsServer.emplace(*port);
+        }
+        _admins = findAdmins(rootDir);
 
-        loadWallets();
+        {
+            std::unique_lock lk(_storageMutex);
+            for (const auto& name : Wallet::loadTimeZoneNames(_storage.writer())) {
+                scheduleNightlyReports(getTimeZone(name));
+            }
+        }
 
-        _bot.emplace(*token, _curlHttpClient);
+        _bot.emplace(*token, _httpClient, apiUrl);
         _bot->getApi().deleteWebhook();
 
         std::vector<TgBot::BotCommand::Ptr> commands;
         _bot->getEvents().onAnyMessage([&](TgBot::Message::Ptr msg) {
             try {
-                SQLite::Transaction tr(_db);
                 auto chat = msg->chat;
                 if (!chat) {
                     return;
@@ -70,8 +121,7 @@ public:
                 if (!amount) {
                     return;
                 }
-
-                auto wallet = loadWallet(chat->id);
+                ScopedTimer timer(_expenseMetrics.duration);
 
                 WalletEntry entry;
                 entry.amount = *amount;
@@ -80,25 +130,32 @@ public:
                 entry.chatId = chat->id;
                 entry.messageId = msg->messageId;
 
-                entry.save(_db);
-
-                _bot->getApi().setMessageReaction(chat->id, msg->messageId, {[] {
-                    auto r = std::make_shared<TgBot::ReactionTypeEmoji>();
-                    r->emoji = "⚡";
-                    return std::move(r);
-                }()},
-                    true);
-
-                tr.commit();
-
-                if (auto tagsKeyboard = Tag::createTagsKeyboard(_db, chat->id, entry.id, msg->messageId)) {
-                    _bot->getApi().sendMessage(chat->id, "❔ Добавить тэг?", nullptr, nullptr, tagsKeyboard);
+                WalletPtr wallet;
+                double daySum;
+                // Waits until the batch with this entry is committed before the reaction below. Under the default
+                // synchronous=NORMAL a commit may still be lost on power failure, synchronous=FULL makes it durable.
+                _groupCommit
+                    .submit([&](Connection& db) {
+                        wallet = loadWallet(chat->id);
+                        entry.save(db, _entryIds, _aggregates, wallet->timeZone);
+                        daySum = _aggregates.get(db, *wallet).daySum;
+                    })
+                    .get();
+                // Before the tags keyboard is sent, so a tag can't reach the hot window ahead of its entry.
+                _hotWindow.onEntrySaved(entry);
+                _reportCache.bumpVersion(chat->id);
+                auto tagsKeyboard = _tagRegistry.get(_storage, chat->id)->createKeyboard(entry.id);
+
+                react(chat->id, msg->messageId);
+
+                if (tagsKeyboard) {
+                    sendMessage(chat->id, "❔ Добавить тэг?", tagsKeyboard);
                 }
 
-                if (wallet.dayLimit == 0) {
+                if (wallet->dayLimit == 0) {
                     return;
                 }
-                const auto delta = wallet.dayLimit - WalletEntry::getDayAmountSum(_db, wallet).amount;
+                const auto delta = wallet->dayLimit - daySum;
                 std::string message;
                 if (delta < 0) {
                     message = fmt::format("🟥 Дефицит дня: {:.0f}", -delta);
@@ -106,10 +163,11 @@ public:
                     message = fmt::format("🟩 Осталось на день: {:.0f}", delta);
                 }
 
-                _bot->getApi().sendMessage(chat->id, message);
+                sendMessage(chat->id, message);
             } catch (const std::exception& e) {
+                _expenseMetrics.errors.add();
                 if (msg->chat) {
-                    _bot->getApi().sendMessage(msg->chat->id,
+                    sendMessage(msg->chat->id,
                         fmt::format("⚠️ Ошибка при выполнении команды: {}", e.what()));
                 }
             }
@@ -120,10 +178,13 @@ public:
                 return;
             }
 
-            auto wallet = loadWallet(chat->id);
+            double daySum;
+            {
+                std::unique_lock lk(_storageMutex);
+                daySum = _aggregates.get(_storage.writer(), *loadWallet(chat->id)).daySum;
+            }
 
-            _bot->getApi().sendMessage(chat->id,
-                fmt::format("{:.0f}", WalletEntry::getDayAmountSum(_db, wallet).amount));
+            sendMessage(chat->id, fmt::format("{:.0f}", daySum));
         });
         addCommand("stat_ten", "Статистика за 10 дней", [&](TgBot::Message::Ptr msg) {
             auto chat = msg->chat;
@@ -131,7 +192,9 @@ public:
                 return;
             }
 
-            auto wallet = loadWallet(chat->id);
+            const auto wallet = getWallet(chat->id);
+            const auto today = absl::ToCivilDay(absl::Now(), wallet->timeZone);
+            const auto data = WalletEntry::toDaySums(*wallet, today, getAmountsByDays(*wallet, today - 9, 10));
 
             Table table2;
             table2.setSize({2, 1});
@@ -140,7 +203,6 @@ public:
             table2.pushRow();
 
             double total = 0;
-            auto data = WalletEntry::getDaysAmountSum(_db, wallet, 10);
             for (std::size_t i = 0; i != 10; ++i) {
                 table2.pushRow();
                 table2.setContentLastRow(0, data[i].day);
@@ -154,9 +216,7 @@ public:
 
             table2.setColumnAlign(1, Align::RIGHT);
 
-            const auto filename = "/tmp/" + std::to_string(chat->id) + ".png";
-            table2.render(filename);
-            _bot->getApi().sendPhoto(chat->id, TgBot::InputFile::fromFile(filename, "image/png"));
+            sendTable(chat->id, std::move(table2));
         });
 
         addCommand("set_day_limit", "Установить дневной лимит", [&](TgBot::Message::Ptr msg) {
@@ -168,32 +228,27 @@ public:
             std::vector<std::string_view> strings = absl::StrSplit(std::string_view(msg->text), ' ');
 
             if (strings.size() != 2) {
-                _bot->getApi().sendMessage(chat->id,
+                sendMessage(chat->id,
                     "⚠️ Необходимо указать дневной лимит. Например: `/set_day_limit 1337`");
                 return;
             }
 
             auto dayLimit = strToDouble(strings[1]);
             if (!dayLimit) {
-                _bot->getApi().sendMessage(chat->id, "⚠️ Дневной лимит должен быть числом. Например: `1337`");
+                sendMessage(chat->id, "⚠️ Дневной лимит должен быть числом. Например: `1337`");
 
                 return;
             }
 
-            SQLite::Transaction tr(_db);
-
-            auto wallet = loadWallet(chat->id);
-            wallet.dayLimit = *dayLimit;
-            updateWallet(chat->id, wallet);
-
-            _bot->getApi().setMessageReaction(chat->id, msg->messageId, {[] {
-                auto r = std::make_shared<TgBot::ReactionTypeEmoji>();
-                r->emoji = "⚡";
-                return std::move(r);
-            }()},
-                true);
+            {
+                std::unique_lock lk(_storageMutex);
+                auto wallet = *loadWallet(chat->id);
+                wallet.dayLimit = *dayLimit;
+                updateWallet(std::move(wallet));
+            }
+            _reportCache.bumpVersion(chat->id);
 
-            tr.commit();
+            react(chat->id, msg->messageId);
         });
         addCommand("get_day_limit", "Узнать дневной лимит", [&](TgBot::Message::Ptr msg) {
             auto chat = msg->chat;
@@ -201,8 +256,12 @@ public:
                 return;
             }
 
-            auto wallet = loadWallet(chat->id);
-            _bot->getApi().sendMessage(chat->id, fmt::format("🕑💰 Дневной лимит: {}", wallet.dayLimit));
+            double dayLimit;
+            {
+                std::unique_lock lk(_storageMutex);
+                dayLimit = loadWallet(chat->id)->dayLimit;
+            }
+            sendMessage(chat->id, fmt::format("🕑💰 Дневной лимит: {}", dayLimit));
         });
 
         auto reportFn = [&](TgBot::Message::Ptr msg, std::size_t daysCount) {
@@ -211,20 +270,27 @@ public:
                 return;
             }
 
-            auto wallet = loadWallet(chat->id);
-            const auto lastDay = absl::ToCivilDay(absl::Now(), wallet.timeZone) - 1;
-
-            Table table2;
-            table2.setSize({4, 1});
-            table2.setContentLastRow(0, "Дата 📅");
-            table2.setContentLastRow(1, "Траты 💸");
-            table2.setContentLastRow(2, "Баланс ⚖️");
-            table2.pushRow();
+            const auto wallet = getWallet(chat->id);
+            const auto lastDay = absl::ToCivilDay(absl::Now(), wallet->timeZone) - 1;
+            const auto cacheKey = _reportCache.key(chat->id, ReportKind::DAYS, daysCount, lastDay + 1);
+            sendReport(chat->id, cacheKey, [this, wallet, lastDay, daysCount]() {
+                std::optional<absl::CivilDay> firstEntryDay;
+                {
+                    std::unique_lock lk(_storageMutex);
+                    firstEntryDay = DayReport::materialize(_storage.writer(), _aggregates, *wallet, lastDay);
+                }
+                const auto reports =
+                    DayReport::loadStoredRange(*_storage.read(), *wallet, firstEntryDay, lastDay, daysCount);
+
+                Table table2;
+                table2.setSize({4, 1});
+                table2.setContentLastRow(0, "Дата 📅");
+                table2.setContentLastRow(1, "Траты 💸");
+                table2.setContentLastRow(2, "Баланс ⚖️");
+                table2.pushRow();
 
-            double totalSum = {};
-            for (std::size_t i = 0; i != daysCount; ++i) {
-                auto report = DayReport::load(_db, wallet, lastDay - i);
-                if (report) {
+                double totalSum = {};
+                for (auto report = reports.rbegin(); report != reports.rend(); ++report) {
                     table2.pushRow();
                     table2.setContentLastRow(0, fmt::format("{:02d}/{:02d}/{}", report->date.day(),
                                                     report->date.month(), report->date.year() % 100));
@@ -233,21 +299,17 @@ public:
                     table2.setContentLastRow(3, report->dayColor());
 
                     totalSum += report->dayExpenses;
-                } else {
-                    break;
                 }
-            }
-            table2.pushRow();
-            table2.pushRow();
-            table2.setContentLastRow(0, "💰💲 Всего");
-            table2.setContentLastRow(2, formatWithApostrophes(totalSum));
+                table2.pushRow();
+                table2.pushRow();
+                table2.setContentLastRow(0, "💰💲 Всего");
+                table2.setContentLastRow(2, formatWithApostrophes(totalSum));
 
-            table2.setColumnAlign(1, Align::RIGHT);
-            table2.setColumnAlign(2, Align::RIGHT);
+                table2.setColumnAlign(1, Align::RIGHT);
+                table2.setColumnAlign(2, Align::RIGHT);
 
-            const auto filename = "/tmp/" + std::to_string(chat->id) + ".png";
-            table2.render(filename);
-            _bot->getApi().sendPhoto(chat->id, TgBot::InputFile::fromFile(filename, "image/png"));
+                return table2;
+            });
         };
 
         addCommand("report", "Узнать отчет за N дней", [&](TgBot::Message::Ptr msg) {
@@ -259,16 +321,20 @@ public:
             std::vector<std::string_view> strings = absl::StrSplit(std::string_view(msg->text), ' ');
 
             if (strings.size() != 2) {
-                _bot->getApi().sendMessage(chat->id, "⚠️ Необходимо указать количество дней. Например: `/report 7`");
+                sendMessage(chat->id, "⚠️ Необходимо указать количество дней. Например: `/report 7`");
                 return;
             }
 
             auto daysCount = strToT<std::size_t>(strings[1]);
             if (!daysCount) {
-                _bot->getApi().sendMessage(chat->id, "⚠️ Количество дней должно быть числом. Например: `7`");
+                sendMessage(chat->id, "⚠️ Количество дней должно быть числом. Например: `7`");
 
                 return;
             }
+            if (*daysCount > DayReport::MAX_DAYS) {
+                sendMessage(chat->id, fmt::format("⚠️ Отчет строится не больше чем за {} дней", DayReport::MAX_DAYS));
+                return;
+            }
 
             reportFn(msg, *daysCount);
         });
@@ -276,6 +342,50 @@ public:
         addCommand("report_7", "Узнать отчет за предыдущую неделю", [&](TgBot::Message::Ptr msg) { reportFn(msg, 7); });
         addCommand("report_30", "Узнать отчет за предыдущий месяц",
             [&](TgBot::Message::Ptr msg) { reportFn(msg, 30); });
+        addCommand("report_range", "Узнать траты за период", [&](TgBot::Message::Ptr msg) {
+            auto chat = msg->chat;
+            if (!chat) {
+                return;
+            }
+
+            std::vector<std::string_view> strings =
+                absl::StrSplit(std::string_view(msg->text), ' ', absl::SkipEmpty());
+            absl::CivilDay first;
+            absl::CivilDay last;
+            if (strings.size() != 3 || !absl::ParseCivilTime(strings[1], &first) ||
+                !absl::ParseCivilTime(strings[2], &last) || first > last) {
+                sendMessage(chat->id,
+                    "⚠️ Необходимо указать период. Например: `/report_range 2026-01-01 2026-03-31`");
+                return;
+            }
+
+            const auto wallet = getWallet(chat->id);
+            const auto today = absl::ToCivilDay(absl::Now(), wallet->timeZone);
+            const auto balanceDay = std::min(last, today - 1);
+            double expenses;
+            double limits;
+            double balance;
+            {
+                std::unique_lock lk(_storageMutex);
+                auto& db = _storage.writer();
+                DayReport::materialize(db, _aggregates, *wallet, today - 1);
+                const auto& sums = _daySums.get(db, chat->id);
+                expenses = sums.expensesSum(first, last);
+                limits = sums.limitsSum(first, last);
+                balance = sums.balance(balanceDay);
+                if (first <= today && today <= last) {
+                    expenses += _aggregates.get(db, *wallet).daySum;
+                }
+            }
+
+            auto formatDay = [](absl::CivilDay day) {
+                return fmt::format("{:02d}/{:02d}/{}", day.day(), day.month(), day.year());
+            };
+            sendMessage(chat->id,
+                fmt::format("📅 {} — {}\n💸 Траты: {}\n🕑💰 Сумма лимитов: {}\n⚖️ Баланс на {}: {}", formatDay(first),
+                    formatDay(last), formatWithApostrophes(expenses), formatWithApostrophes(limits),
+                    formatDay(balanceDay), formatWithApostrophes(balance)));
+        });
         addCommand("add_tag", "Добавить тэг трат", [&](TgBot::Message::Ptr msg) {
             auto chat = msg->chat;
             if (!chat) {
@@ -285,24 +395,27 @@ public:
             std::vector<std::string_view> strings = absl::StrSplit(std::string_view(msg->text), ' ');
 
             if (strings.size() < 2) {
-                _bot->getApi().sendMessage(chat->id, "⚠️ Необходимо указать тег. Например: `/add_tag 🍟 Еда`");
+                sendMessage(chat->id, "⚠️ Необходимо указать тег. Например: `/add_tag 🍟 Еда`");
                 return;
             }
 
             const auto tag = std::string(strings[1].data(), strings.back().data() + strings.back().size());
 
-            auto wallet = loadWallet(chat->id);
-
-            Tag walletTag;
-            walletTag.chatId = wallet.chatId;
-            walletTag.tag = tag;
+            {
+                std::unique_lock lk(_storageMutex);
+                Tag walletTag;
+                walletTag.chatId = loadWallet(chat->id)->chatId;
+                walletTag.tag = tag;
 
-            walletTag.save(_db);
+                walletTag.save(_storage.writer());
+            }
+            _tagRegistry.invalidate(chat->id);
 
-            _bot->getApi().sendMessage(chat->id, fmt::format("✅ Тэг добавлен: {}", tag));
+            sendMessage(chat->id, fmt::format("✅ Тэг добавлен: {}", tag));
         });
 
         _bot->getEvents().onCallbackQuery([&](const TgBot::CallbackQuery::Ptr query) {
+            ScopedTimer timer(_callbackMetrics.duration);
             try {
                 if (!query->message || !query->message->chat) {
                     return;
@@ -316,7 +429,7 @@ public:
                 }
 
                 if (strings[0] == DELETE_MESSAGE) {
-                    _bot->getApi().deleteMessage(chat->id, query->message->messageId);
+                    deleteMessage(chat->id, query->message->messageId);
                 } else if (strings[0] == ADD_ENTRY_TAG) {
                     if (strings.size() != 3) {
                         return;
@@ -335,11 +448,19 @@ public:
                     EntryTag eTag;
                     eTag.entryId = *entryId;
                     eTag.tagId = *tagId;
-                    if (!eTag.save(_db)) {
+                    bool isSaved = false;
+                    _groupCommit
+                        .submit([&](Connection& db) {
+                            isSaved = eTag.save(db, chat->id, loadWallet(chat->id)->timeZone);
+                        })
+                        .get();
+                    if (!isSaved) {
                         return;
                     }
+                    _hotWindow.onEntryTagged(chat->id, eTag.entryId, eTag.tagId);
+                    _reportCache.bumpVersion(chat->id);
 
-                    _bot->getApi().deleteMessage(chat->id, query->message->messageId);
+                    deleteMessage(chat->id, query->message->messageId);
                 } else if (strings[0] == REFRESH_TAGS) {
                     // 3rd param is dummy
                     if (strings.size() != 3) {
@@ -351,15 +472,17 @@ public:
                         return;
                     }
 
-                    if (auto tagsKeyboard =
-                            Tag::createTagsKeyboard(_db, chat->id, *entryId, query->message->messageId)) {
-                        _bot->getApi().editMessageText("❔ Добавить тэг?", chat->id, query->message->messageId, "", "",
-                            nullptr, tagsKeyboard);
+                    if (auto tagsKeyboard = _tagRegistry.get(_storage, chat->id)->createKeyboard(*entryId)) {
+                        _outbound.post(chat->id, [this, chatId = chat->id, messageId = query->message->messageId,
+                                                     tagsKeyboard]() {
+                            _bot->getApi().editMessageText("❔ Добавить тэг?", chatId, messageId, "", "", nullptr,
+                                tagsKeyboard);
+                        });
                     }
                 }
             } catch (const std::exception& e) {
                 if (query->message && query->message->chat) {
-                    _bot->getApi().sendMessage(query->message->chat->id,
+                    sendMessage(query->message->chat->id,
                         fmt::format("⚠️ Ошибка при выполнении команды: {}", e.what()));
                 }
             }
@@ -371,44 +494,46 @@ public:
                 return;
             }
 
-            auto wallet = loadWallet(chat->id);
-
-            auto report = WalletEntry::getReportByTags(_db, wallet, daysCount);
-            auto tagsMap = Tag::tagsIdToStr(_db, chat->id);
+            const auto wallet = getWallet(chat->id);
+            const auto cacheKey = _reportCache.key(chat->id, ReportKind::TAGS, daysCount,
+                absl::ToCivilDay(absl::Now(), wallet->timeZone));
+            sendReport(chat->id, cacheKey, [this, wallet, daysCount]() {
+                const auto report = getReportByTags(*wallet, daysCount);
+                const auto tags = _tagRegistry.get(_storage, wallet->chatId);
+                const auto& tagsMap = tags->names;
+
+                Table table2;
+                table2.setSize({3, 1});
+                table2.setContentLastRow(0, "Тэг 🏷️");
+                table2.setContentLastRow(1, "Сумма 💰");
+                table2.setContentLastRow(2, "Доля %");
+                table2.pushRow();
 
-            Table table2;
-            table2.setSize({3, 1});
-            table2.setContentLastRow(0, "Тэг 🏷️");
-            table2.setContentLastRow(1, "Сумма 💰");
-            table2.setContentLastRow(2, "Доля %");
-            table2.pushRow();
+                for (const auto& t : report.byTags) {
+                    auto tagStrIt = tagsMap.find(t.first);
+                    std::string_view name;
+                    if (tagStrIt != tagsMap.end()) {
+                        name = tagStrIt->second;
+                    } else {
+                        name = "📛 Неизвестный тэг";
+                    }
 
-            for (const auto& t : report.byTags) {
-                auto tagStrIt = tagsMap.find(t.first);
-                std::string_view name;
-                if (tagStrIt != tagsMap.end()) {
-                    name = tagStrIt->second;
-                } else {
-                    name = "📛 Неизвестный тэг";
+                    table2.pushRow();
+                    table2.setContentLastRow(0, name);
+                    table2.setContentLastRow(1, fmt::format("{}", formatWithApostrophes(t.second)));
+                    table2.setContentLastRow(2, fmt::format("{:.0f}", 100 * t.second / report.total));
                 }
 
                 table2.pushRow();
-                table2.setContentLastRow(0, name);
-                table2.setContentLastRow(1, fmt::format("{}", formatWithApostrophes(t.second)));
-                table2.setContentLastRow(2, fmt::format("{:.0f}", 100 * t.second / report.total));
-            }
-
-            table2.pushRow();
-            table2.pushRow();
-            table2.setContentLastRow(0, "💰💲 Всего");
-            table2.setContentLastRow(1, fmt::format("{}", formatWithApostrophes(report.total)));
+                table2.pushRow();
+                table2.setContentLastRow(0, "💰💲 Всего");
+                table2.setContentLastRow(1, fmt::format("{}", formatWithApostrophes(report.total)));
 
-            table2.setColumnAlign(1, Align::RIGHT);
-            table2.setColumnAlign(2, Align::RIGHT);
+                table2.setColumnAlign(1, Align::RIGHT);
+                table2.setColumnAlign(2, Align::RIGHT);
 
-            const auto filename = "/tmp/" + std::to_string(chat->id) + ".png";
-            table2.render(filename);
-            _bot->getApi().sendPhoto(chat->id, TgBot::InputFile::fromFile(filename, "image/png"));
+                return table2;
+            });
         };
         addCommand("total_report", "Узнать сумарный отчет", [&](TgBot::Message::Ptr msg) {
             auto chat = msg->chat;
@@ -419,17 +544,21 @@ public:
             std::vector<std::string_view> strings = absl::StrSplit(std::string_view(msg->text), ' ');
 
             if (strings.size() != 2) {
-                _bot->getApi().sendMessage(chat->id,
+                sendMessage(chat->id,
                     "⚠️ Необходимо указать количество дней. Например: `/total_report 7`");
                 return;
             }
 
             auto daysCount = strToT<std::size_t>(strings[1]);
             if (!daysCount) {
-                _bot->getApi().sendMessage(chat->id, "⚠️ Количество дней должно быть числом. Например: `7`");
+                sendMessage(chat->id, "⚠️ Количество дней должно быть числом. Например: `7`");
 
                 return;
             }
+            if (*daysCount > DayReport::MAX_DAYS) {
+                sendMessage(chat->id, fmt::format("⚠️ Отчет строится не больше чем за {} дней", DayReport::MAX_DAYS));
+                return;
+            }
 
             tagsReportFn(msg, *daysCount);
         });
@@ -440,24 +569,97 @@ public:
         addCommand("total_report_30", "Узнать сумарный отчет за 30 дней",
             [&](TgBot::Message::Ptr msg) { tagsReportFn(msg, 30); });
 
+        // Not listed in the commands menu, used to size the render pool.
+        _bot->getEvents().onCommand("render_stats", [&](TgBot::Message::Ptr msg) {
+            if (!msg->chat) {
+                return;
+            }
+
+            const auto stats = _renderPool.stats();
+            const auto avgRenderTime =
+                stats.rendered ? stats.totalRenderTime / static_cast<std::int64_t>(stats.rendered) : absl::Duration{};
+            sendMessage(msg->chat->id,
+                fmt::format("🖼 Очередь: {} (макс. {})\nОтрисовано: {}, ошибок: {}\nСреднее время: {}, макс.: {}",
+                    stats.queueDepth, stats.maxQueueDepth, stats.rendered, stats.failed,
+                    absl::FormatDuration(avgRenderTime), absl::FormatDuration(stats.maxRenderTime)));
+        });
+
+        // Hidden as well, answers only chats listed in the admins file.
+        _bot->getEvents().onCommand("metrics", [&](TgBot::Message::Ptr msg) {
+            if (!msg->chat || !_admins.count(msg->chat->id)) {
+                return;
+            }
+
+            auto summary = Metrics::get().summary(METRICS_SUMMARY_LINES);
+            sendMessage(msg->chat->id, summary.empty() ? "📊 Пока ничего не измерено" : "📊 " + summary);
+        });
+
         run();
     }
 
 private:
     void run() {
         _bot->getApi().setMyCommands(_commands);
-        TgBot::TgLongPoll longPoll(*_bot);
+
+        UpdateDispatcher dispatcher(_bot->getEventHandler(), UPDATE_THREADS, UPDATE_QUEUE_SIZE);
+        std::int32_t offset = 0;
         while (true) {
             try {
-                longPoll.start();
+                for (auto& update : _bot->getApi().getUpdates(offset, 100, 10)) {
+                    offset = std::max(offset, update->updateId + 1);
+                    dispatcher.dispatch(std::move(update));
+                }
             } catch (const std::exception& e) {
-                std::cout << e.what();
+                std::cerr << "getUpdates: " << e.what() << '\n';
             }
         }
     }
 
-    void loadWallets() {
-        Wallet::loadForEach(_db, [&](const Wallet& wallet) { _wallets.emplace(wallet.chatId, wallet); });
+    // Must be called under _storageMutex.
+    void scheduleNightlyReports(const absl::TimeZone& timeZone) {
+        if (_nightlyReportsTimeZones.insert(timeZone.name()).second) {
+            scheduleNextNightlyReports(timeZone);
+        }
+    }
+
+    void scheduleNextNightlyReports(absl::TimeZone timeZone) {
+        const auto nextDay = absl::ToCivilDay(absl::Now(), timeZone) + 1;
+        _scheduler.schedule(absl::FromCivil(nextDay, timeZone) + NIGHTLY_REPORTS_DELAY, [this, timeZone](absl::Time) {
+            scheduleNextNightlyReports(timeZone);
+            materializeNightlyReports(timeZone);
+        });
+    }
+
+    // Stores yesterday's DayReport of every wallet in the time zone, so reports only read precomputed rows.
+    void materializeNightlyReports(const absl::TimeZone& timeZone) {
+        const auto yesterday = absl::ToCivilDay(absl::Now(), timeZone) - 1;
+
+        std::vector<Wallet> wallets;
+        {
+            std::unique_lock lk(_storageMutex);
+            Wallet::loadForEachInTimeZone(_storage.writer(), timeZone.name(),
+                [&](const Wallet& wallet) { wallets.push_back(wallet); });
+        }
+
+        // Batches keep the writer available for expenses between them.
+        for (std::size_t first = 0; first < wallets.size(); first += NIGHTLY_REPORTS_BATCH_SIZE) {
+            const auto last = std::min(wallets.size(), first + NIGHTLY_REPORTS_BATCH_SIZE);
+
+            std::unique_lock lk(_storageMutex);
+            auto& db = _storage.writer();
+            try {
+                SQLite::Transaction tr(db);
+                for (auto i = first; i != last; ++i) {
+                    DayReport::materializeUncached(db, _aggregates, wallets[i], yesterday);
+                }
+                tr.commit();
+            } catch (...) {
+                // Aggregates already count the rolled back reports as closed days, and day sums may include them.
+                _aggregates.clear();
+                _daySums.clear();
+                throw;
+            }
+        }
     }
 
     template<class Fn>
@@ -467,46 +669,200 @@ private:
         command->description = descr;
         _commands.push_back(std::move(command));
 
-        _bot->getEvents().onCommand(name, [&, fn = std::move(fn)](TgBot::Message::Ptr msg) {
+        auto metrics = commandMetrics(name);
+        _bot->getEvents().onCommand(name, [&, fn = std::move(fn), metrics](TgBot::Message::Ptr msg) {
+            ScopedTimer timer(metrics.duration);
             try {
                 fn(msg);
             } catch (const std::exception& e) {
+                metrics.errors.add();
                 if (msg->chat) {
-                    _bot->getApi().sendMessage(msg->chat->id,
+                    sendMessage(msg->chat->id,
                         fmt::format("⚠️ Ошибка при выполнении команды: {}", e.what()));
                 }
             }
         });
     }
 
-    Wallet loadWallet(std::int64_t chatId) {
-        auto foundChat = _wallets.find(chatId);
-        if (foundChat == _wallets.end()) {
-            Wallet w = {};
-            w.save(_db);
-            foundChat = _wallets.emplace(chatId, std::move(w)).first;
+    struct CommandMetrics {
+        Histogram& duration;
+        Counter& errors;
+    };
+
+    static CommandMetrics commandMetrics(const std::string& name) {
+        const auto labels = fmt::format("command=\"{}\"", name);
+        return {Metrics::get().histogram("wallet_command_duration_seconds", labels),
+            Metrics::get().counter("wallet_command_errors_total", labels)};
+    }
+
+    // The chat's place for the image is reserved before rendering, so replies sent meanwhile don't overtake it.
+    void sendTable(std::int64_t chatId, Table table) {
+        renderTable(_outbound.reserve(chatId), std::move(table));
+    }
+
+    // Uploaded image is remembered under `cacheKey`, if one is given.
+    void renderTable(const OutboundQueue::Slot& slot, Table table,
+        std::optional<ReportCache::Key> cacheKey = std::nullopt) {
+        _renderPool.submit(std::move(table), [this, slot, cacheKey](std::optional<std::string> png) {
+            _outbound.fill(slot, [this, chatId = slot.chatId, cacheKey, png = std::move(png)]() mutable {
+                if (!png) {
+                    return;
+                }
+                try {
+                    auto sent = sendPng(chatId, std::move(*png));
+                    if (cacheKey && sent && !sent->photo.empty()) {
+                        _reportCache.insert(*cacheKey, sent->photo.back()->fileId);
+                    }
+                } catch (const std::exception& e) {
+                    sendMessage(chatId, fmt::format("⚠️ Ошибка при выполнении команды: {}", e.what()));
+                }
+            });
+        });
+    }
+
+    TgBot::Message::Ptr sendPng(std::int64_t chatId, std::string png) {
+        auto photo = std::make_shared<TgBot::InputFile>();
+        photo->data = std::move(png);
+        photo->mimeType = "image/png";
+        photo->fileName = "report.png";
+
+        return _bot->getApi().sendPhoto(chatId, photo);
+    }
+
+    // Resends the image cached under `key`, or renders the table returned by `buildTable`. Telegram may stop accepting
+    // an old file_id, then the table is built and rendered in place of the failed call.
+    void sendReport(std::int64_t chatId, const ReportCache::Key& key, std::function<Table()> buildTable) {
+        auto fileId = _reportCache.find(key);
+        if (!fileId) {
+            renderTable(_outbound.reserve(chatId), buildTable(), key);
+            return;
         }
-        return foundChat->second;
+
+        _outbound.post(chatId, [this, chatId, key, fileId = std::move(*fileId), buildTable = std::move(buildTable)]() {
+            try {
+                _bot->getApi().sendPhoto(chatId, fileId);
+                return;
+            } catch (const std::exception& e) {
+                std::cerr << "sendPhoto: " << e.what() << '\n';
+                _reportCache.erase(key);
+            }
+
+            try {
+                auto table = buildTable();
+                renderTable(_outbound.reserveNext(chatId), std::move(table), key);
+            } catch (const std::exception& e) {
+                sendMessage(chatId, fmt::format("⚠️ Ошибка при выполнении команды: {}", e.what()));
+            }
+        });
+    }
+
+    void sendMessage(std::int64_t chatId, std::string text, TgBot::GenericReply::Ptr replyMarkup = nullptr) {
+        _outbound.post(chatId, [this, chatId, text = std::move(text), replyMarkup]() {
+            _bot->getApi().sendMessage(chatId, text, nullptr, nullptr, replyMarkup);
+        });
+    }
+
+    void deleteMessage(std::int64_t chatId, std::int32_t messageId) {
+        _outbound.post(chatId, [this, chatId, messageId]() { _bot->getApi().deleteMessage(chatId, messageId); });
+    }
+
+    void react(std::int64_t chatId, std::int32_t messageId) {
+        _outbound.postUnordered([this, chatId, messageId]() {
+            _bot->getApi().setMessageReaction(chatId, messageId, {[] {
+                auto r = std::make_shared<TgBot::ReactionTypeEmoji>();
+                r->emoji = "⚡";
+                return std::move(r);
+            }()},
+                true);
+        });
+    }
+
+    // Served from the hot window when it covers the days, from a read snapshot otherwise.
+    std::vector<double> getAmountsByDays(const Wallet& wallet, absl::CivilDay firstDay, std::size_t daysCount) {
+        if (auto amounts = _hotWindow.amountsByDays(_storage, wallet, firstDay, daysCount)) {
+            return std::move(*amounts);
+        }
+        return WalletEntry::getAmountsByDays(*_storage.read(), wallet, firstDay, daysCount);
+    }
+
+    WalletEntry::TagsReport getReportByTags(const Wallet& wallet, std::size_t daysCount) {
+        if (auto report = _hotWindow.reportByTags(_storage, wallet, daysCount)) {
+            return std::move(*report);
+        }
+        return WalletEntry::getReportByTags(*_storage.read(), wallet, daysCount);
     }
 
-    void updateWallet(std::int64_t chatId, const Wallet& wallet) {
-        auto foundChat = _wallets.find(chatId);
-        if (foundChat == _wallets.end()) {
-            wallet.save(_db);
+    // Takes _storageMutex only when the wallet isn't cached.
+    WalletPtr getWallet(std::int64_t chatId) {
+        if (auto wallet = _wallets.find(chatId)) {
+            return wallet;
+        }
+        std::unique_lock lk(_storageMutex);
+        return loadStoredWallet(chatId);
+    }
+
+    // Must be called under _storageMutex.
+    WalletPtr loadWallet(std::int64_t chatId) {
+        if (auto wallet = _wallets.find(chatId)) {
+            return wallet;
+        }
+        return loadStoredWallet(chatId);
+    }
 
-            foundChat = _wallets.emplace(chatId, wallet).first;
-        } else {
-            foundChat->second = wallet;
-            wallet.save(_db);
+    // Wallets are read on first access, so startup doesn't depend on the number of chats. A chat without one gets the
+    // default wallet, saved right away.
+    WalletPtr loadStoredWallet(std::int64_t chatId) {
+        auto stored = Wallet::load(_storage.writer(), chatId);
+        if (!stored) {
+            stored = Wallet{};
+            stored->chatId = chatId;
+            stored->save(_storage.writer());
+            scheduleNightlyReports(stored->timeZone);
         }
+
+        auto wallet = std::make_shared<const Wallet>(std::move(*stored));
+        _wallets.insert(wallet);
+        return wallet;
+    }
+
+    // Must be called under _storageMutex. The new wallet replaces the cached one after it is committed, handlers that
+    // already got the old one finish with it.
+    void updateWallet(Wallet wallet) {
+        SQLite::Transaction tr(_storage.writer());
+        wallet.save(_storage.writer());
+        tr.commit();
+
+        scheduleNightlyReports(wallet.timeZone);
+        _wallets.insert(std::make_shared<const Wallet>(std::move(wallet)));
     }
 
 private:
-    SQLite::Database _db;
+    // Guards the storage writer, _entryIds, _aggregates and _daySums, and loading of wallets into _wallets.
+    // Handlers hold it only around storage access and never across Bot API calls. Reads go through pooled snapshots and
+    // cached wallets and don't need it.
+    std::mutex _storageMutex;
+    Storage _storage;
     std::optional<TgBot::Bot> _bot;
 
-    std::unordered_map<std::int64_t, Wallet> _wallets;
-    TgBot::CurlHttpClient _curlHttpClient;
+    WalletCache _wallets;
+    EntryIds _entryIds;
+    WalletAggregates _aggregates;
+    HotWindow _hotWindow;
+    DaySumsIndex _daySums;
+    GroupCommitWriter _groupCommit;
+    std::unordered_set<std::string> _nightlyReportsTimeZones;
+    ReportCache _reportCache;
+    TagRegistry _tagRegistry;
+    CurlMultiHttpClient _httpClient{HTTP_MAX_CONNECTIONS};
 
     std::vector<TgBot::BotCommand::Ptr> _commands;
+    std::unordered_set<std::int64_t> _admins;
+    CommandMetrics _expenseMetrics = commandMetrics("expense");
+    CommandMetrics _callbackMetrics = commandMetrics("callback");
+    std::optional<MetricsServer> _metricsServer;
+
+    // Declared last, so workers are joined before anything their callbacks use is destroyed.
+    OutboundQueue _outbound{OUTBOUND_THREADS};
+    Scheduler _scheduler;
+    RenderPool _renderPool;
 };
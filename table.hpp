@@ -67,17 +67,19 @@ struct Table {
         return data[c.x][c.y];
     }
 
-    void render(const std::string& ouputFile) {
+    // Returns the table rendered as PNG image.
+    std::string render() {
         std::size_t lineHeight = 0;
         std::vector<std::size_t> columnsWidth(data.size(), 0);
 
+        auto& measurer = TextMeasurer::get();
         for (std::size_t x = 0; x != data.size(); ++x) {
             for (std::size_t y = 0; y != data.front().size(); ++y) {
                 auto& c = getCell({x, y});
                 if (c.merge == Merge::SLAVE) {
                     continue;
                 }
-                std::tie(c.size.x, c.size.y) = calcTextSize(c.text);
+                std::tie(c.size.x, c.size.y) = measurer.textSize(c.text);
                 c.textSize = c.size;
                 lineHeight = std::max(lineHeight, c.size.y);
                 columnsWidth[x] = std::max(columnsWidth[x], c.size.x);
@@ -112,12 +114,9 @@ struct Table {
         cr->set_source_rgb(55 / 255.0f, 55 / 255.0f, 77 / 255.0f);
         cr->paint();
 
-        Pango::FontDescription fontDesc(DEFAULT_FONT);
-        fontDesc.set_size(DEFAULT_FONT_SIZE);
-
         auto layout = Pango::Layout::create(cr);
         layout->set_wrap(Pango::WRAP_CHAR);
-        layout->set_font_description(fontDesc);
+        layout->set_font_description(measurer.fontDescription());
         Pango::AttrList list;
         Pango::Attribute attr = Pango::Attribute::create_attr_foreground(65535 * (222 / 255.0f), 65535 * (222 / 255.0f),
             65535 * (222 / 255.0f));
@@ -138,7 +137,7 @@ struct Table {
             }
         }
 
-        surface->write_to_png(ouputFile);
+        return writePng(surface);
     }
 
 private:
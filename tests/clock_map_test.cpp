@@ -0,0 +1,54 @@
+#include "clock_map.hpp"
+
+#include <gtest/gtest.h>
+
+TEST(ClockMap, EvictsValueNotUsedSinceHandPassed) {
+    ClockMap<int, int> map(2);
+    map.insert(1, 10);
+    map.insert(2, 20);
+    ASSERT_NE(map.find(1), nullptr);
+
+    map.insert(3, 30);
+    EXPECT_EQ(map.size(), 2u);
+    EXPECT_EQ(map.evictionsCount(), 1u);
+    EXPECT_EQ(*map.find(1), 10);
+    EXPECT_EQ(map.find(2), nullptr);
+    EXPECT_EQ(*map.find(3), 30);
+}
+
+TEST(ClockMap, ContainsDoesntProtectFromEviction) {
+    ClockMap<int, int> map(2);
+    map.insert(1, 10);
+    map.insert(2, 20);
+    ASSERT_TRUE(map.contains(1));
+
+    map.insert(3, 30);
+    EXPECT_FALSE(map.contains(1));
+    EXPECT_TRUE(map.contains(2));
+}
+
+TEST(ClockMap, InsertReplacesValue) {
+    ClockMap<int, int> map(2);
+    map.insert(1, 10);
+    map.insert(1, 11);
+    EXPECT_EQ(map.size(), 1u);
+    EXPECT_EQ(*map.find(1), 11);
+}
+
+TEST(ClockMap, EraseKeepsOtherKeys) {
+    ClockMap<int, int> map(3);
+    map.insert(1, 10);
+    map.insert(2, 20);
+    map.insert(3, 30);
+
+    map.erase(1);
+    map.erase(4);
+    EXPECT_EQ(map.size(), 2u);
+    EXPECT_EQ(map.find(1), nullptr);
+    EXPECT_EQ(*map.find(2), 20);
+    EXPECT_EQ(*map.find(3), 30);
+
+    map.insert(4, 40);
+    EXPECT_EQ(map.evictionsCount(), 0u);
+    EXPECT_EQ(*map.find(4), 40);
+}
@@ -0,0 +1,159 @@
+#include "curl_multi_http_client.hpp"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <fmt/format.h>
+
+#include <gtest/gtest.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <future>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+// Answers one HTTP/1.1 request on a loopback port with `status` and a JSON `body`.
+class OneShotHttpServer {
+public:
+    OneShotHttpServer(std::string status, std::string body): _fd(socket(AF_INET, SOCK_STREAM, 0)) {
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        socklen_t addrSize = sizeof(addr);
+        if (_fd < 0 || bind(_fd, reinterpret_cast<sockaddr*>(&addr), addrSize) != 0 || listen(_fd, 1) != 0 ||
+            getsockname(_fd, reinterpret_cast<sockaddr*>(&addr), &addrSize) != 0) {
+            throw std::runtime_error("can't listen on loopback");
+        }
+        _port = ntohs(addr.sin_port);
+
+        _thread = std::thread([this, status = std::move(status), body = std::move(body)]() { serve(status, body); });
+    }
+
+    ~OneShotHttpServer() {
+        _thread.join();
+        close(_fd);
+    }
+
+    std::string url(const std::string& path) const {
+        return fmt::format("http://127.0.0.1:{}{}", _port, path);
+    }
+
+    // Head and body of the served request.
+    std::string request() {
+        return _request.get_future().get();
+    }
+
+private:
+    void serve(const std::string& status, const std::string& body) {
+        const int client = accept(_fd, nullptr, nullptr);
+        std::string request;
+        std::size_t headEnd = std::string::npos;
+        while ((headEnd = request.find("\r\n\r\n")) == std::string::npos && receive(client, request)) {
+        }
+
+        const auto head = request.substr(0, headEnd);
+        std::size_t contentLength = 0;
+        if (const auto pos = head.find("Content-Length: "); pos != std::string::npos) {
+            contentLength = std::stoul(head.substr(pos + 16));
+        }
+        if (head.find("Expect: 100-continue") != std::string::npos) {
+            sendAll(client, "HTTP/1.1 100 Continue\r\n\r\n");
+        }
+        while (request.size() < headEnd + 4 + contentLength && receive(client, request)) {
+        }
+        _request.set_value(request);
+
+        sendAll(client, fmt::format("HTTP/1.1 {}\r\nContent-Type: application/json\r\nContent-Length: {}\r\n"
+                                    "Connection: close\r\n\r\n{}",
+                            status, body.size(), body));
+        close(client);
+    }
+
+    static bool receive(int fd, std::string& data) {
+        char buffer[4096];
+        const auto size = recv(fd, buffer, sizeof(buffer), 0);
+        if (size <= 0) {
+            return false;
+        }
+        data.append(buffer, size);
+        return true;
+    }
+
+    static void sendAll(int fd, const std::string& data) {
+        for (std::size_t sent = 0; sent != data.size();) {
+            const auto size = send(fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+            if (size <= 0) {
+                return;
+            }
+            sent += size;
+        }
+    }
+
+    int _fd;
+    std::uint16_t _port;
+    std::promise<std::string> _request;
+    std::thread _thread;
+};
+
+}
+
+TEST(CurlMultiHttpClient, SendsPlainFieldsWithoutContentType) {
+    OneShotHttpServer server("200 OK", R"({"ok":true,"result":true})");
+    CurlMultiHttpClient client;
+
+    const auto response = client.makeRequest(TgBot::Url(server.url("/bot123/sendMessage")),
+        {TgBot::HttpReqArg("chat_id", "42"), TgBot::HttpReqArg("text", "Привет")});
+    EXPECT_EQ(response, R"({"ok":true,"result":true})");
+
+    const auto request = server.request();
+    EXPECT_EQ(request.rfind("POST /bot123/sendMessage HTTP/1.1\r\n", 0), 0u);
+    EXPECT_NE(request.find("Content-Type: multipart/form-data; boundary="), std::string::npos);
+    EXPECT_NE(request.find("Content-Disposition: form-data; name=\"chat_id\"\r\n\r\n42\r\n"), std::string::npos);
+    EXPECT_NE(request.find("Content-Disposition: form-data; name=\"text\"\r\n\r\nПривет\r\n"), std::string::npos);
+}
+
+TEST(CurlMultiHttpClient, SendsFilePartWithNameAndType) {
+    OneShotHttpServer server("200 OK", R"({"ok":true})");
+    CurlMultiHttpClient client;
+
+    const std::string png("\x89PNG\r\n\x1a\n\0data", 12);
+    client.makeRequest(TgBot::Url(server.url("/bot123/sendPhoto")),
+        {TgBot::HttpReqArg("chat_id", "42"), TgBot::HttpReqArg("photo", png, true, "image/png", "report.png")});
+
+    const auto request = server.request();
+    EXPECT_NE(request.find("Content-Disposition: form-data; name=\"photo\"; filename=\"report.png\"\r\n"
+                           "Content-Type: image/png\r\n\r\n" +
+                  png + "\r\n"),
+        std::string::npos);
+}
+
+TEST(CurlMultiHttpClient, ReturnsBodyOfErrorResponse) {
+    // TgBot::Api takes the error description from the body.
+    const std::string body = R"({"ok":false,"error_code":400,"description":"Bad Request: chat not found"})";
+    OneShotHttpServer server("400 Bad Request", body);
+    CurlMultiHttpClient client;
+
+    EXPECT_EQ(client.makeRequest(TgBot::Url(server.url("/bot123/getMe")), {}), body);
+    EXPECT_EQ(server.request().rfind("GET /bot123/getMe", 0), 0u);
+}
+
+TEST(CurlMultiHttpClient, ThrowsWhenServerIsUnreachable) {
+    std::string url;
+    {
+        // Nothing listens on the port once the server is gone.
+        OneShotHttpServer server("200 OK", "{}");
+        url = server.url("/bot123/getMe");
+        CurlMultiHttpClient client;
+        client.makeRequest(TgBot::Url(url), {});
+    }
+
+    CurlMultiHttpClient client;
+    EXPECT_THROW(client.makeRequest(TgBot::Url(url), {}), std::runtime_error);
+}
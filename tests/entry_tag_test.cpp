@@ -0,0 +1,55 @@
+#include "db/connection.hpp"
+#include "db/entry_tag.hpp"
+#include "db/tag.hpp"
+#include "db/wallet_aggregates.hpp"
+#include "db/wallet_entry.hpp"
+#include "migration.hpp"
+#include "utils.hpp"
+
+#include <absl/time/clock.h>
+#include <absl/time/time.h>
+
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <filesystem>
+
+namespace {
+
+constexpr std::int64_t CHAT_ID = 42;
+constexpr std::int64_t OTHER_CHAT_ID = 43;
+
+std::int64_t countEntryTags(Connection& db) {
+    SQLite::Statement query(db, "SELECT COUNT(*) FROM EntryTags");
+    query.executeStep();
+    return query.getColumn(0).getInt64();
+}
+
+// Tag callbacks carry ids chosen by the client, so a chat must not be able to tag entries of another one.
+TEST(EntryTag, DoesntTagEntryOfAnotherChat) {
+    const auto path = std::filesystem::temp_directory_path() / "wallet_entry_tag_test.db";
+    std::filesystem::remove(path);
+    {
+        Connection db(path, SQLite::OPEN_READWRITE | SQLite::OPEN_CREATE);
+        Migration(WALLET_SOURCE_DIR, db);
+        const auto timeZone = getTimeZone("UTC");
+
+        Tag{0, OTHER_CHAT_ID, "🍟 Еда"}.save(db);
+        std::int64_t tagId = 0;
+        Tag::loadForEach(db, OTHER_CHAT_ID, [&](Tag tag) { tagId = tag.id; });
+
+        EntryIds ids;
+        WalletAggregates aggregates;
+        WalletEntry entry{0, OTHER_CHAT_ID, absl::Now(), 100, "test", 1};
+        entry.save(db, ids, aggregates, timeZone);
+
+        EXPECT_FALSE((EntryTag{entry.id, tagId}.save(db, CHAT_ID, timeZone)));
+        EXPECT_EQ(countEntryTags(db), 0);
+
+        EXPECT_TRUE((EntryTag{entry.id, tagId}.save(db, OTHER_CHAT_ID, timeZone)));
+        EXPECT_EQ(countEntryTags(db), 1);
+    }
+    std::filesystem::remove(path);
+}
+
+} // namespace
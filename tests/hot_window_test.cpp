@@ -0,0 +1,102 @@
+#include "db/hot_window.hpp"
+#include "db/storage.hpp"
+#include "db/wallet.hpp"
+#include "db/wallet_aggregates.hpp"
+#include "db/wallet_entry.hpp"
+#include "migration.hpp"
+#include "utils.hpp"
+
+#include <absl/time/clock.h>
+#include <absl/time/time.h>
+
+#include <gtest/gtest.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <limits>
+#include <vector>
+
+namespace {
+
+class HotWindowTest : public testing::Test {
+protected:
+    HotWindowTest() {
+        Migration(WALLET_SOURCE_DIR, _storage.writer());
+    }
+
+    ~HotWindowTest() override {
+        removeDb();
+    }
+
+    Wallet addWallet(std::int64_t chatId, std::size_t entriesCount) {
+        Wallet wallet{chatId, getTimeZone("UTC"), 1000};
+        wallet.save(_storage.writer());
+        for (std::size_t i = 0; i != entriesCount; ++i) {
+            save(wallet, 100 + i);
+        }
+        return wallet;
+    }
+
+    WalletEntry save(const Wallet& wallet, double amount) {
+        WalletEntry entry{0, wallet.chatId, absl::Now() - absl::Seconds(1), amount, "test", 1};
+        entry.save(_storage.writer(), _ids, _aggregates, wallet.timeZone);
+        return entry;
+    }
+
+    std::vector<double> amountsFromDb(const Wallet& wallet) {
+        return WalletEntry::getAmountsByDays(*_storage.read(), wallet, firstDay(wallet), 2);
+    }
+
+    static absl::CivilDay firstDay(const Wallet& wallet) {
+        return absl::ToCivilDay(absl::Now(), wallet.timeZone) - 1;
+    }
+
+    static std::filesystem::path removeDb() {
+        const auto path = std::filesystem::temp_directory_path() / "wallet_hot_window_test.db";
+        for (const auto* suffix : {"", "-wal", "-shm"}) {
+            std::filesystem::remove(path.string() + suffix);
+        }
+        return path;
+    }
+
+    Storage _storage{removeDb(), StorageConfig{}};
+    EntryIds _ids;
+    WalletAggregates _aggregates;
+};
+
+} // namespace
+
+TEST_F(HotWindowTest, AppliesCommittedSavesToLoadedWallet) {
+    HotWindow window(7, std::numeric_limits<std::size_t>::max());
+    const auto wallet = addWallet(1, 2);
+    EXPECT_EQ(window.amountsByDays(_storage, wallet, firstDay(wallet), 2), amountsFromDb(wallet));
+
+    window.onEntrySaved(save(wallet, 50));
+    EXPECT_EQ(window.amountsByDays(_storage, wallet, firstDay(wallet), 2), amountsFromDb(wallet));
+}
+
+TEST_F(HotWindowTest, DoesntServeDaysBeforeWindow) {
+    HotWindow window(7, std::numeric_limits<std::size_t>::max());
+    const auto wallet = addWallet(1, 1);
+    EXPECT_EQ(window.amountsByDays(_storage, wallet, firstDay(wallet) - 30, 2), std::nullopt);
+}
+
+TEST_F(HotWindowTest, EvictsLeastRecentlyUsedWallet) {
+    const auto first = addWallet(1, 1);
+    const auto second = addWallet(2, 2);
+    const auto third = addWallet(3, 3);
+    std::vector<std::size_t> bytes;
+    for (const auto& wallet : {first, second, third}) {
+        HotWindow window(7, std::numeric_limits<std::size_t>::max());
+        window.amountsByDays(_storage, wallet, firstDay(wallet), 2);
+        bytes.push_back(window.bytes());
+    }
+
+    HotWindow window(7, bytes[0] + bytes[1] + bytes[2] - 1);
+    window.amountsByDays(_storage, first, firstDay(first), 2);
+    window.amountsByDays(_storage, second, firstDay(second), 2);
+    window.amountsByDays(_storage, first, firstDay(first), 2);
+    window.amountsByDays(_storage, third, firstDay(third), 2);
+    EXPECT_EQ(window.bytes(), bytes[0] + bytes[2]);
+}
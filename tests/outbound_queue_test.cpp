@@ -0,0 +1,36 @@
+#include "outbound_queue.hpp"
+
+#include <gtest/gtest.h>
+
+#include <future>
+#include <mutex>
+#include <string>
+#include <vector>
+
+TEST(OutboundQueue, ReservedNextSlotRunsBeforeLaterCalls) {
+    std::mutex mutex;
+    std::vector<std::string> order;
+    auto record = [&](std::string name) {
+        std::unique_lock lk(mutex);
+        order.push_back(std::move(name));
+    };
+
+    std::promise<OutboundQueue::Slot> reserved;
+    std::promise<void> isDone;
+    {
+        OutboundQueue queue(4);
+        queue.post(1, [&]() {
+            // A later call is already queued when the running one gives up its reply.
+            queue.post(1, [&]() { record("later"); });
+            reserved.set_value(queue.reserveNext(1));
+            record("failed");
+        });
+
+        const auto slot = reserved.get_future().get();
+        queue.fill(slot, [&]() { record("replacement"); });
+        queue.post(1, [&]() { isDone.set_value(); });
+        isDone.get_future().wait();
+    }
+
+    EXPECT_EQ(order, (std::vector<std::string>{"failed", "replacement", "later"}));
+}
@@ -0,0 +1,97 @@
+#include "db/connection.hpp"
+#include "db/day_report.hpp"
+#include "db/day_sums.hpp"
+#include "db/entry_tag.hpp"
+#include "db/hot_window.hpp"
+#include "db/tag.hpp"
+#include "db/tag_day_totals.hpp"
+#include "db/tag_registry.hpp"
+#include "db/wallet.hpp"
+#include "db/wallet_aggregates.hpp"
+#include "db/wallet_entry.hpp"
+#include "migration.hpp"
+#include "utils.hpp"
+
+#include <absl/time/clock.h>
+#include <absl/time/time.h>
+
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+namespace {
+
+constexpr std::int64_t CHAT_ID = 42;
+
+// Plan steps of `query` that read a whole table.
+std::vector<std::string> fullScans(Connection& db, const std::string& query) {
+    std::vector<std::string> scans;
+    SQLite::Statement explain(db, "EXPLAIN QUERY PLAN " + query);
+    while (explain.executeStep()) {
+        auto detail = explain.getColumn(3).getString();
+        if (detail.rfind("SCAN ", 0) == 0 && detail != "SCAN CONSTANT ROW") {
+            scans.push_back(std::move(detail));
+        }
+    }
+    return scans;
+}
+
+// Runs every model query on a migrated scratch database, then checks the plans of all statements the connection has
+// prepared on the way, so a new query is covered as soon as a model uses it.
+TEST(QueryPlans, ModelQueriesDontScan) {
+    const auto path = std::filesystem::temp_directory_path() / "wallet_query_plans_test.db";
+    std::filesystem::remove(path);
+    {
+        Connection db(path, SQLite::OPEN_READWRITE | SQLite::OPEN_CREATE);
+        Migration(WALLET_SOURCE_DIR, db);
+
+        const auto timeZone = getTimeZone("UTC");
+        const auto now = absl::Now();
+        const auto today = absl::ToCivilDay(now, timeZone);
+
+        Wallet wallet{CHAT_ID, timeZone, 1000};
+        wallet.save(db);
+        Wallet::load(db, CHAT_ID);
+        Wallet::loadForEachInTimeZone(db, timeZone.name(), [](const Wallet&) {});
+        Wallet::loadTimeZoneNames(db);
+
+        Tag tag{0, CHAT_ID, "🍟 Еда"};
+        tag.save(db);
+        const auto tags = ChatTags::load(db, CHAT_ID);
+        ASSERT_EQ(tags.names.size(), 1u);
+
+        EntryIds ids;
+        WalletAggregates aggregates;
+        WalletEntry entry{0, CHAT_ID, now - absl::Hours(3 * 24), 100, "test", 1};
+        entry.save(db, ids, aggregates, timeZone);
+        const auto tagId = static_cast<std::int64_t>(tags.names.begin()->first);
+        EXPECT_TRUE((EntryTag{entry.id, tagId}.save(db, CHAT_ID, timeZone)));
+        EntryTag::loadForEach(db, entry.id, [](EntryTag) {});
+
+        WalletEntry::loadForEach(db, CHAT_ID, now - absl::Hours(30 * 24), now, [](const WalletEntry&) {});
+        WalletEntry::getAmountsByDays(db, wallet, today - 9, 10);
+        WalletEntry::getReportByTags(db, wallet, 30);
+        aggregates.get(db, wallet);
+        DayReport::loadRange(db, aggregates, wallet, today - 1, 7);
+        DaySums().extend(db, CHAT_ID);
+        WalletColumns::load(db, CHAT_ID, 0);
+
+        db.exec("INSERT INTO TagDayTotalsBackfill VALUES(" + std::to_string(CHAT_ID) + ")");
+        TagDayTotals::backfill(db);
+
+        std::size_t checkedCount = 0;
+        db.forEachPrepared([&](const std::string& query, QueryPlan plan) {
+            if (plan == QueryPlan::SEARCH) {
+                EXPECT_EQ(fullScans(db, query), std::vector<std::string>{}) << query;
+                ++checkedCount;
+            }
+        });
+        EXPECT_NE(checkedCount, 0u);
+    }
+    std::filesystem::remove(path);
+}
+
+} // namespace
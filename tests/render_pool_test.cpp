@@ -0,0 +1,48 @@
+#include "render_pool.hpp"
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <cstddef>
+#include <mutex>
+#include <optional>
+#include <string>
+
+TEST(RenderPool, QueuedTasksGetNulloptWhenPoolStops) {
+    constexpr std::size_t TASKS_COUNT = 5;
+
+    std::size_t callsCount = 0;
+    std::size_t renderedCount = 0;
+    {
+        // Without workers nothing is taken from the queue.
+        RenderPool pool(0, TASKS_COUNT);
+        for (std::size_t i = 0; i != TASKS_COUNT; ++i) {
+            pool.submit(Table{}, [&](std::optional<std::string> png) {
+                ++callsCount;
+                renderedCount += png.has_value();
+            });
+        }
+        EXPECT_EQ(callsCount, 0u);
+    }
+
+    EXPECT_EQ(callsCount, TASKS_COUNT);
+    EXPECT_EQ(renderedCount, 0u);
+}
+
+TEST(RenderPool, EveryCallbackFiresOnceWhenStoppingWithBusyWorkers) {
+    constexpr std::size_t TASKS_COUNT = 64;
+
+    std::atomic<std::size_t> callsCount = 0;
+    {
+        RenderPool pool(2, TASKS_COUNT);
+        for (std::size_t i = 0; i != TASKS_COUNT; ++i) {
+            Table table;
+            table.setSize({2, 2});
+            table.setContent({0, 0}, "Дата");
+            table.setContent({1, 1}, std::to_string(i));
+            pool.submit(std::move(table), [&](std::optional<std::string>) { ++callsCount; });
+        }
+    }
+
+    EXPECT_EQ(callsCount, TASKS_COUNT);
+}
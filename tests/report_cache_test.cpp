@@ -0,0 +1,46 @@
+#include "report_cache.hpp"
+
+#include <gtest/gtest.h>
+
+#include <cstdint>
+
+namespace {
+
+const absl::CivilDay DAY(2026, 1, 1);
+
+}
+
+TEST(ReportCache, BumpedVersionDropsReports) {
+    ReportCache cache;
+    const auto key = cache.key(1, ReportKind::DAYS, 7, DAY);
+    cache.insert(key, "file");
+    EXPECT_EQ(cache.find(key), "file");
+
+    cache.bumpVersion(1);
+    EXPECT_EQ(cache.find(key), std::nullopt);
+    cache.insert(key, "stale");
+    EXPECT_EQ(cache.find(cache.key(1, ReportKind::DAYS, 7, DAY)), std::nullopt);
+}
+
+TEST(ReportCache, KeepsAtMostMaxCachedChats) {
+    ReportCache cache;
+    const auto first = cache.key(0, ReportKind::DAYS, 7, DAY);
+    for (std::int64_t chatId = 1; chatId <= static_cast<std::int64_t>(ReportCache::MAX_CACHED_CHATS); ++chatId) {
+        cache.insert(cache.key(chatId, ReportKind::DAYS, 7, DAY), "file");
+    }
+
+    // The first chat was evicted, and the report built for its old version isn't accepted after it comes back.
+    cache.insert(first, "stale");
+    EXPECT_EQ(cache.find(first), std::nullopt);
+    EXPECT_EQ(cache.find(cache.key(0, ReportKind::DAYS, 7, DAY)), std::nullopt);
+}
+
+TEST(ReportCache, KeepsAtMostMaxReportsPerChat) {
+    ReportCache cache;
+    for (std::size_t daysCount = 1; daysCount <= ReportCache::MAX_REPORTS_PER_CHAT + 1; ++daysCount) {
+        cache.insert(cache.key(1, ReportKind::DAYS, daysCount, DAY), "file");
+    }
+
+    EXPECT_EQ(cache.find(cache.key(1, ReportKind::DAYS, 1, DAY)), std::nullopt);
+    EXPECT_EQ(cache.find(cache.key(1, ReportKind::DAYS, 2, DAY)), "file");
+}
@@ -0,0 +1,104 @@
+#pragma once
+
+#include <tgbot/Bot.h>
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Hands polled updates to a fixed set of worker threads. Updates are sharded by chat id, so updates of one chat are
+// handled in order by a single worker while different chats proceed in parallel. Every shard queue is bounded,
+// dispatch() blocks the poller when the target shard is full.
+class UpdateDispatcher {
+public:
+    UpdateDispatcher(const TgBot::EventHandler& eventHandler, std::size_t shardsCount, std::size_t maxShardQueueSize):
+        _eventHandler(eventHandler), _maxShardQueueSize(maxShardQueueSize) {
+        for (std::size_t i = 0; i != shardsCount; ++i) {
+            _shards.push_back(std::make_unique<Shard>());
+        }
+        for (auto& shard : _shards) {
+            shard->thread = std::thread([this, s = shard.get()]() { work(*s); });
+        }
+    }
+
+    ~UpdateDispatcher() {
+        for (auto& shard : _shards) {
+            {
+                std::unique_lock lk(shard->mutex);
+                shard->isRunning = false;
+            }
+            shard->hasUpdates.notify_all();
+            shard->hasSpace.notify_all();
+        }
+        for (auto& shard : _shards) {
+            shard->thread.join();
+        }
+    }
+
+    void dispatch(TgBot::Update::Ptr update) {
+        auto& shard = *_shards[std::hash<std::int64_t>{}(chatId(*update)) % _shards.size()];
+
+        std::unique_lock lk(shard.mutex);
+        shard.hasSpace.wait(lk, [&]() { return shard.updates.size() < _maxShardQueueSize || !shard.isRunning; });
+        if (!shard.isRunning) {
+            return;
+        }
+        shard.updates.push_back(std::move(update));
+        shard.hasUpdates.notify_one();
+    }
+
+private:
+    struct Shard {
+        std::mutex mutex;
+        std::condition_variable hasUpdates;
+        std::condition_variable hasSpace;
+        std::deque<TgBot::Update::Ptr> updates;
+        bool isRunning = true;
+        std::thread thread;
+    };
+
+    static std::int64_t chatId(const TgBot::Update& update) {
+        if (update.message && update.message->chat) {
+            return update.message->chat->id;
+        }
+        if (update.callbackQuery && update.callbackQuery->message && update.callbackQuery->message->chat) {
+            return update.callbackQuery->message->chat->id;
+        }
+        return 0;
+    }
+
+    void work(Shard& shard) {
+        std::unique_lock lk(shard.mutex);
+        while (true) {
+            shard.hasUpdates.wait(lk, [&]() { return !shard.updates.empty() || !shard.isRunning; });
+            if (!shard.isRunning) {
+                return;
+            }
+
+            auto update = std::move(shard.updates.front());
+            shard.updates.pop_front();
+            shard.hasSpace.notify_one();
+            lk.unlock();
+
+            try {
+                _eventHandler.handleUpdate(update);
+            } catch (const std::exception& e) {
+                std::cerr << "UpdateDispatcher: " << e.what() << '\n';
+            }
+
+            lk.lock();
+        }
+    }
+
+private:
+    const TgBot::EventHandler& _eventHandler;
+    std::size_t _maxShardQueueSize;
+    std::vector<std::unique_ptr<Shard>> _shards;
+};
@@ -2,10 +2,15 @@
 
 #include <algorithm>
 #include <charconv>
+#include <cstdint>
 #include <filesystem>
 #include <fstream>
+#include <functional>
+#include <map>
+#include <mutex>
 #include <optional>
 #include <string>
+#include <unordered_set>
 
 #include <absl/strings/charconv.h>
 #include <absl/time/time.h>
@@ -21,6 +26,29 @@ inline std::optional<std::string> findToken(const std::filesystem::path& rootDir
     return token;
 }
 
+// Local port of the metrics endpoint, disabled when there is no metrics_port file.
+inline std::optional<std::uint16_t> findMetricsPort(const std::filesystem::path& rootDir) noexcept {
+    std::uint16_t port;
+    std::ifstream portFile(rootDir / "metrics_port");
+    if (!portFile.is_open() || !(portFile >> port)) {
+        return {};
+    }
+
+    return port;
+}
+
+// Chats allowed to run service commands, one chat id per line of the admins file.
+inline std::unordered_set<std::int64_t> findAdmins(const std::filesystem::path& rootDir) {
+    std::unordered_set<std::int64_t> admins;
+    std::ifstream adminsFile(rootDir / "admins");
+    std::int64_t chatId;
+    while (adminsFile >> chatId) {
+        admins.insert(chatId);
+    }
+
+    return admins;
+}
+
 inline std::optional<double> strToDouble(std::string_view str) {
     double result;
     if (absl::from_chars(str.begin(), str.end(), result).ec != std::errc()) {
@@ -38,7 +66,7 @@ inline std::optional<int> strToInt(std::string_view str) {
 }
 
 template<class T>
-inline std::optional<int> strToT(std::string_view str) {
+inline std::optional<T> strToT(std::string_view str) {
     T result;
     if (std::from_chars(str.begin(), str.end(), result).ec != std::errc()) {
         return {};
@@ -57,11 +85,30 @@ inline std::string formatWithApostrophes(std::int64_t num) {
     return s;
 }
 
+// Days are stored as YYYYMMDD integers.
+inline std::int64_t dateToInt(absl::CivilDay day) {
+    return day.day() + day.month() * 100 + day.year() * 10000;
+}
+
+inline absl::CivilDay intToDate(std::int64_t dayInt) {
+    return absl::CivilDay(dayInt / 10000, (dayInt / 100) % 100, dayInt % 100);
+}
+
+// Zones are interned by name: wallets share a handful of them, and loading one goes through absl's zoneinfo lookup.
 inline absl::TimeZone getTimeZone(std::string_view str) {
+    static std::mutex mutex;
+    static std::map<std::string, absl::TimeZone, std::less<>> zones;
+
+    std::unique_lock lk(mutex);
+    auto found = zones.find(str);
+    if (found != zones.end()) {
+        return found->second;
+    }
+
     absl::TimeZone tz;
     if (!absl::LoadTimeZone(str, &tz)) {
         absl::LoadTimeZone("Europe/Moscow", &tz);
-        return tz;
     }
+    zones.emplace(str, tz);
     return tz;
 }